@@ -0,0 +1,207 @@
+/*######################################################################
+
+ Benchmark : collective communications of examples 3 to 12
+
+ Description:
+   Examples 3 to 12 each time one collective call once, with their
+   own banner. This program times all of them in one run, with the
+   same buffers as the examples (vectors of buffsize doubles filled
+   with random values, one vector per task for the root of Scatter,
+   buffsize/(itask+1) elements sent to task itask by Scatterv):
+
+     bcast     : example 3
+     scatter   : example 7
+     scatterv  : example 8
+     gather    : example 9
+     allgather : example 10
+     alltoall  : example 11
+     reduce    : example 12 (MPI::SUM)
+
+   The vector size goes from minsize to maxsize, doubling at each
+   step, and the calls are made on the first ntasks tasks for
+   ntasks = 2, 4, 8, ... up to the total number of tasks (the
+   communicators come from MPI::COMM_WORLD.Split). Each task measures
+   the average time of niter calls (totaltime); the minimum, average
+   and maximum over the tasks are obtained by Reduce on task 0.
+
+   Task 0 prints a table and writes every measure in a JSON file:
+
+     [ { "collective": "bcast", "ntasks": 4, "buffsize": 1024,
+         "bytes": 8192, "min": ..., "avg": ..., "max": ... }, ... ]
+
+   with the times in seconds.
+
+   Usage: benchmark [minsize] [maxsize] [niter] [file.json]
+
+ Last update: October 2026
+
+######################################################################*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <mpi.h>
+
+enum Collective { BCAST, SCATTER, SCATTERV, GATHER, ALLGATHER, ALLTOALL, REDUCE };
+const int   ncollectives = 7;
+const char *names[ncollectives] = { "bcast", "scatter", "scatterv", "gather",
+                                    "allgather", "alltoall", "reduce" };
+
+/* One call of the collective c on comm */
+void CallCollective ( Collective c, const MPI::Intracomm& comm, int buffsize,
+                      double* sendbuff, double* recvbuff, int* sendcounts, int* displs );
+
+int main(int argc,char** argv)
+{
+   int           taskid, ntasks, subtasks, subid;
+   int           minsize, maxsize, buffsize, niter, iter, c, i, first = 1;
+   int           *sendcounts, *displs;
+   double        *sendbuff, *recvbuff;
+   double        inittime, totaltime, mintime, maxtime, sumtime;
+   const char    *filename;
+   FILE          *json = NULL;
+   MPI::Intracomm comm;
+
+   /*===============================================================*/
+   /* MPI Initialisation.                                           */
+   MPI::Init(argc, argv);
+   taskid = MPI::COMM_WORLD.Get_rank();
+   ntasks = MPI::COMM_WORLD.Get_size();
+
+   /*===============================================================*/
+   /* Arguments.                                                    */
+   minsize  = ( argc > 1 ) ? atoi(argv[1]) : 1;
+   maxsize  = ( argc > 2 ) ? atoi(argv[2]) : 65536;
+   niter    = ( argc > 3 ) ? atoi(argv[3]) : 100;
+   filename = ( argc > 4 ) ? argv[4] : "benchmark.json";
+   if ( minsize <= 0 ) minsize = 1;
+   if ( maxsize < minsize ) maxsize = minsize;
+   if ( niter <= 0 ) niter = 100;
+
+   if ( taskid == 0 ){
+     json = fopen(filename, "w");
+     if ( json == NULL ){
+       printf("Cannot open %s\n", filename);
+       MPI::COMM_WORLD.Abort(1);
+     }
+     fprintf(json, "[\n");
+     printf("\n##########################################################\n\n");
+     printf(" Benchmark of the collective communications\n\n");
+     printf(" Vector sizes: %d to %d\n", minsize, maxsize);
+     printf(" Number of tasks: %d, %d calls per measure\n\n", ntasks, niter);
+     printf("##########################################################\n\n");
+     printf("%-10s %7s %9s %12s %12s %12s\n",
+            "collective", "ntasks", "buffsize", "min (s)", "avg (s)", "max (s)");
+   }
+
+   /*===============================================================*/
+   /* Memory allocation, for the largest case: a vector per task    */
+   /* on both sides of Alltoall.                                    */
+   sendbuff   = new double[(size_t)ntasks*maxsize];
+   recvbuff   = new double[(size_t)ntasks*maxsize];
+   sendcounts = new int[ntasks];
+   displs     = new int[ntasks];
+
+   srand((unsigned)time( NULL ) + taskid);
+   for(size_t k=0;k<(size_t)ntasks*maxsize;k++) sendbuff[k]=(double)rand()/RAND_MAX;
+
+   /*===============================================================*/
+   /* Subsets of tasks: 2, 4, 8, ..., ntasks.                       */
+   subtasks = ( ntasks < 2 ) ? ntasks : 2;
+   while ( true ){
+
+     comm = MPI::COMM_WORLD.Split(( taskid < subtasks ) ? 0 : MPI::UNDEFINED, taskid);
+
+     for(buffsize=minsize; buffsize<=maxsize; buffsize*=2){
+       for(c=0;c<ncollectives;c++){
+         if ( comm != MPI::COMM_NULL ){
+           subid = comm.Get_rank();
+
+           /* Scatterv: buffsize/(itask+1) elements for task itask */
+           for(i=0;i<subtasks;i++){
+             displs[i]=i*buffsize;
+             sendcounts[i]=buffsize/(i+1);
+           }
+
+           /* One call to warm up, then niter timed calls */
+           CallCollective((Collective)c, comm, buffsize, sendbuff, recvbuff, sendcounts, displs);
+           comm.Barrier();
+           inittime = MPI::Wtime();
+           for(iter=0;iter<niter;iter++){
+             CallCollective((Collective)c, comm, buffsize, sendbuff, recvbuff, sendcounts, displs);
+           }
+           totaltime = ( MPI::Wtime() - inittime ) / niter;
+
+           comm.Reduce(&totaltime, &mintime, 1, MPI::DOUBLE, MPI::MIN, 0);
+           comm.Reduce(&totaltime, &maxtime, 1, MPI::DOUBLE, MPI::MAX, 0);
+           comm.Reduce(&totaltime, &sumtime, 1, MPI::DOUBLE, MPI::SUM, 0);
+
+           if ( subid == 0 ){
+             printf("%-10s %7d %9d %12.4e %12.4e %12.4e\n",
+                    names[c], subtasks, buffsize, mintime, sumtime/subtasks, maxtime);
+             fprintf(json, "%s  { \"collective\": \"%s\", \"ntasks\": %d, \"buffsize\": %d, "
+                     "\"bytes\": %ld, \"min\": %e, \"avg\": %e, \"max\": %e }",
+                     first ? "" : ",\n", names[c], subtasks, buffsize,
+                     (long)buffsize*(long)sizeof(double), mintime, sumtime/subtasks, maxtime);
+             first = 0;
+           }
+         }
+       }
+       if ( buffsize > maxsize/2 ) break;
+     }
+
+     if ( comm != MPI::COMM_NULL ) comm.Free();
+     if ( subtasks == ntasks ) break;
+     subtasks = ( 2*subtasks < ntasks ) ? 2*subtasks : ntasks;
+   }
+
+   if ( taskid == 0 ){
+     fprintf(json, "\n]\n");
+     fclose(json);
+     printf("\nResults written in %s\n\n", filename);
+   }
+
+   /*===============================================================*/
+   /* Free the allocated memory.                                    */
+   delete [] sendbuff;
+   delete [] recvbuff;
+   delete [] sendcounts;
+   delete [] displs;
+
+   MPI::Finalize();
+}
+
+void CallCollective ( Collective c, const MPI::Intracomm& comm, int buffsize,
+                      double* sendbuff, double* recvbuff, int* sendcounts, int* displs )
+{
+   int subid = comm.Get_rank();
+
+   switch ( c ){
+     case BCAST:
+       comm.Bcast(sendbuff, buffsize, MPI::DOUBLE, 0);
+       break;
+     case SCATTER:
+       comm.Scatter(sendbuff, buffsize, MPI::DOUBLE,
+                    recvbuff, buffsize, MPI::DOUBLE, 0);
+       break;
+     case SCATTERV:
+       comm.Scatterv(sendbuff, sendcounts, displs, MPI::DOUBLE,
+                     recvbuff, buffsize/(subid+1), MPI::DOUBLE, 0);
+       break;
+     case GATHER:
+       comm.Gather(sendbuff, buffsize, MPI::DOUBLE,
+                   recvbuff, buffsize, MPI::DOUBLE, 0);
+       break;
+     case ALLGATHER:
+       comm.Allgather(sendbuff, buffsize, MPI::DOUBLE,
+                      recvbuff, buffsize, MPI::DOUBLE);
+       break;
+     case ALLTOALL:
+       comm.Alltoall(sendbuff, buffsize, MPI::DOUBLE,
+                     recvbuff, buffsize, MPI::DOUBLE);
+       break;
+     case REDUCE:
+       comm.Reduce(sendbuff, recvbuff, buffsize, MPI::DOUBLE, MPI::SUM, 0);
+       break;
+   }
+}
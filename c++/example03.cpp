@@ -57,6 +57,7 @@
 #include <time.h>
 #include <math.h>
 #include <mpi.h>
+#include "mpi_stats.h"
 
 int main(int argc,char** argv){
 
@@ -65,6 +66,8 @@ int main(int argc,char** argv){
    int          buffsize;
    double       *buff,buffsum;
    double       inittime,totaltime;
+   PerfCounters counters;
+   TimingStats  stats;
 
    /*===============================================================*/
    /* MPI Initialisation. It's important to put this call at the    */
@@ -122,11 +125,17 @@ int main(int argc,char** argv){
    /*===============================================================*/
    /* Communication.                                                */
 
+   counters.Start();
    inittime = MPI::Wtime();
 
    MPI::COMM_WORLD.Bcast(buff,buffsize,MPI::DOUBLE,0);
 
    totaltime = MPI::Wtime() - inittime;
+   counters.Stop();
+
+   /*===============================================================*/
+   /* Statistics of totaltime over all the tasks, on task 0.        */
+   stats = ReduceTimings(totaltime,&counters);
 
    /*===============================================================*/
    /* Print out after communication.                                */
@@ -149,7 +158,7 @@ int main(int argc,char** argv){
    if(taskid==0){
      printf("\n");
      printf("##########################################################\n\n");
-     printf(" Communication time : %f seconds\n\n",totaltime);
+     PrintTimings("Communication time",stats);
      printf("##########################################################\n\n");
    }
 
@@ -84,6 +84,7 @@
 #include <time.h>
 #include <math.h>
 #include <mpi.h>
+#include "mpi_trace.h"
 
 int main(int argc,char** argv)
 {
@@ -91,13 +92,14 @@ int main(int argc,char** argv)
    MPI::Status  status;
    int          ierr,i,j,itask;
    int          buffsize;
-   double       **sendbuff,*recvbuff,buffsum,buffsums[1024];
+   double       **sendbuff=NULL,*recvbuff=NULL,buffsum,buffsums[1024];
    double       inittime,totaltime,recvtime,recvtimes[1024];
 
    /*===============================================================*/
    /* MPI Initialisation. Its important to put this call at the     */
    /* begining of the program, after variable declarations.         */
    MPI::Init(argc, argv);
+   TraceInit();
 
    /*===============================================================*/
    /* Get the number of MPI tasks and the taskid of this task.      */
@@ -169,6 +171,7 @@ int main(int argc,char** argv)
 
      for(itask=1 ; itask<ntasks ; itask++){
 
+       TraceScope trace("Send", itask);
        MPI::COMM_WORLD.Send(sendbuff[itask],
                             buffsize,
                             MPI::DOUBLE,
@@ -179,23 +182,32 @@ int main(int argc,char** argv)
    }
    else{
 
-     MPI::COMM_WORLD.Recv(recvbuff,
-                          buffsize,
-                          MPI::DOUBLE,
-                          0,
-                          MPI::ANY_TAG,
-                          status);
+     {
+       TraceScope trace("Recv", 0);
+       MPI::COMM_WORLD.Recv(recvbuff,
+                            buffsize,
+                            MPI::DOUBLE,
+                            0,
+                            MPI::ANY_TAG,
+                            status);
+     }
 
      recvtime = MPI::Wtime();
 
-     buffsum=0.0;
-     for(i=0 ; i<buffsize ; i++){
-       buffsum=buffsum+recvbuff[i];
+     {
+       TraceScope trace("Sum", -1, "compute");
+       buffsum=0.0;
+       for(i=0 ; i<buffsize ; i++){
+         buffsum=buffsum+recvbuff[i];
+       }
      }
 
    }
 
-   MPI::COMM_WORLD.Barrier();
+   {
+     TraceScope trace("Barrier");
+     MPI::COMM_WORLD.Barrier();
+   }
 
    totaltime=MPI::Wtime() - inittime;
 
@@ -236,6 +248,7 @@ int main(int argc,char** argv)
 
    /*===============================================================*/
    /* MPI finalisation.                                             */
+   TraceFinalize();
    MPI::Finalize();
 
 }
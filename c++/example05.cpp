@@ -77,6 +77,7 @@
 #include <time.h>
 #include <math.h>
 #include <mpi.h>
+#include "mpi_trace.h"
 
 int main(int argc,char** argv)
 {
@@ -94,6 +95,7 @@ int main(int argc,char** argv)
    /* MPI Initialisation. Its important to put this call at the     */
    /* begining of the program, after variable declarations.         */
    MPI::Init(argc, argv);
+   TraceInit();
 
    /*===============================================================*/
    /* Get the number of MPI tasks and the taskid of this task.      */
@@ -155,28 +157,43 @@ int main(int argc,char** argv)
    inittime = MPI::Wtime();
 
    if ( taskid == 0 ){
-     MPI::COMM_WORLD.Recv(recvbuff,buffsize,MPI::DOUBLE,
-                          ntasks-1,MPI::ANY_TAG,status);
+     {
+       TraceScope trace("Recv", ntasks-1);
+       MPI::COMM_WORLD.Recv(recvbuff,buffsize,MPI::DOUBLE,
+                            ntasks-1,MPI::ANY_TAG,status);
+     }
      recvtime = MPI::Wtime();
+     TraceScope trace("Send", taskid+1);
      MPI::COMM_WORLD.Send(sendbuff,buffsize,MPI::DOUBLE,
                           taskid+1,0);
    }
    else if( taskid == ntasks-1 ){
-     MPI::COMM_WORLD.Send(sendbuff,buffsize,MPI::DOUBLE,
-                          0,0);
+     {
+       TraceScope trace("Send", 0);
+       MPI::COMM_WORLD.Send(sendbuff,buffsize,MPI::DOUBLE,
+                            0,0);
+     }
+     TraceScope trace("Recv", taskid-1);
      MPI::COMM_WORLD.Recv(recvbuff,buffsize,MPI::DOUBLE,
                           taskid-1,MPI::ANY_TAG,status);
      recvtime = MPI::Wtime();
    }
    else{
-     MPI::COMM_WORLD.Recv(recvbuff,buffsize,MPI::DOUBLE,
-                          taskid-1,MPI::ANY_TAG,status);
+     {
+       TraceScope trace("Recv", taskid-1);
+       MPI::COMM_WORLD.Recv(recvbuff,buffsize,MPI::DOUBLE,
+                            taskid-1,MPI::ANY_TAG,status);
+     }
      recvtime = MPI::Wtime();
+     TraceScope trace("Send", taskid+1);
      MPI::COMM_WORLD.Send(sendbuff,buffsize,MPI::DOUBLE,
                           taskid+1,0);
    }
 
-   MPI::COMM_WORLD.Barrier();
+   {
+     TraceScope trace("Barrier");
+     MPI::COMM_WORLD.Barrier();
+   }
 
    totaltime=MPI::Wtime() - inittime;
 
@@ -217,6 +234,7 @@ int main(int argc,char** argv)
 
    /*===============================================================*/
    /* MPI finalisation.                                             */
+   TraceFinalize();
    MPI::Finalize();
 
 }
@@ -78,6 +78,7 @@
 #include <time.h>
 #include <math.h>
 #include <mpi.h>
+#include "mpi_trace.h"
 
 int main(int argc,char** argv)
 {
@@ -95,6 +96,7 @@ int main(int argc,char** argv)
    /* MPI Initialisation. It's important to put this call at the    */
    /* begining of the program, after variable declarations.         */
    MPI::Init(argc, argv);
+   TraceInit();
 
    /*===============================================================*/
    /* Get the number of MPI tasks and the taskid of this task.      */
@@ -175,8 +177,14 @@ int main(int argc,char** argv)
                                           taskid-1,MPI::ANY_TAG);
      recvtime = MPI::Wtime();
    }
-   send_request.Wait(status);
-   recv_request.Wait(status);
+   {
+     TraceScope trace("Wait send");
+     send_request.Wait(status);
+   }
+   {
+     TraceScope trace("Wait recv");
+     recv_request.Wait(status);
+   }
 
    totaltime=MPI::Wtime() - inittime;
 
@@ -216,6 +224,7 @@ int main(int argc,char** argv)
 
    /*===============================================================*/
    /* MPI finalisation.                                             */
+   TraceFinalize();
    MPI::Finalize();
 
 }
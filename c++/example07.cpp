@@ -84,6 +84,7 @@
 #include <time.h>
 #include <math.h>
 #include <mpi.h>
+#include "mpi_stats.h"
 
 int main(int argc,char** argv)
 {
@@ -93,6 +94,8 @@ int main(int argc,char** argv)
    int          buffsize;
    double       **sendbuff,*recvbuff,buffsum,buffsums[1024];
    double       inittime,totaltime,recvtime,recvtimes[1024];
+   PerfCounters counters;
+   TimingStats  stats;
 
    /*===============================================================*/
    /* MPI Initialisation. It's important to put this call at the    */
@@ -164,6 +167,7 @@ int main(int argc,char** argv)
    /*===============================================================*/
    /* Communication.                                                */
 
+   counters.Start();
    inittime = MPI::Wtime();
 
    MPI::COMM_WORLD.Scatter(sendbuff[0],buffsize,MPI::DOUBLE,
@@ -171,6 +175,11 @@ int main(int argc,char** argv)
                            0);
 
    totaltime = MPI::Wtime() - inittime;
+   counters.Stop();
+
+   /*===============================================================*/
+   /* Statistics of totaltime over all the tasks, on task 0.        */
+   stats = ReduceTimings(totaltime,&counters);
 
    /*===============================================================*/
    /* Print out after communication.                                */
@@ -193,7 +202,7 @@ int main(int argc,char** argv)
      }
      printf("\n");
      printf("##########################################################\n\n");
-     printf(" Communication time : %f seconds\n\n",totaltime);
+     PrintTimings("Communication time",stats);
      printf("##########################################################\n\n");
    }
 
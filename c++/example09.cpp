@@ -77,6 +77,7 @@
 #include <time.h>
 #include <math.h>
 #include <mpi.h>
+#include "mpi_stats.h"
 
 int main(int argc,char** argv)
 {
@@ -86,6 +87,8 @@ int main(int argc,char** argv)
    int          buffsize;
    double       *sendbuff,**recvbuff,buffsum;
    double       inittime,totaltime;
+   PerfCounters counters;
+   TimingStats  stats;
 
    /*===============================================================*/
    /* MPI Initialisation. It's important to put this call at the    */
@@ -150,6 +153,7 @@ int main(int argc,char** argv)
    /*===============================================================*/
    /* Communication.                                                */
 
+   counters.Start();
    inittime = MPI::Wtime();
 
    MPI::COMM_WORLD.Gather(sendbuff,buffsize,MPI::DOUBLE,
@@ -157,6 +161,11 @@ int main(int argc,char** argv)
                           0);
 
    totaltime = MPI::Wtime() - inittime;
+   counters.Stop();
+
+   /*===============================================================*/
+   /* Statistics of totaltime over all the tasks, on task 0.        */
+   stats = ReduceTimings(totaltime,&counters);
 
    /*===============================================================*/
    /* Print out after communication.                                */
@@ -178,7 +187,7 @@ int main(int argc,char** argv)
    if(taskid==0){
      printf("\n");
      printf("##########################################################\n\n");
-     printf(" Communication time : %f seconds\n\n",totaltime);
+     PrintTimings("Communication time",stats);
      printf("##########################################################\n\n");
    }
 
@@ -76,6 +76,7 @@
 #include <time.h>
 #include <math.h>
 #include <mpi.h>
+#include "mpi_stats.h"
 
 int main(int argc,char** argv)
 {
@@ -85,6 +86,8 @@ int main(int argc,char** argv)
    int          buffsize;
    double       *sendbuff,**recvbuff,buffsum;
    double       inittime,totaltime;
+   PerfCounters counters;
+   TimingStats  stats;
 
    /*===============================================================*/
    /* MPI Initialisation. Its important to put this call at the     */
@@ -141,12 +144,18 @@ int main(int argc,char** argv)
    /*===============================================================*/
    /* Communication.                                                */
 
+   counters.Start();
    inittime = MPI::Wtime();
 
    MPI::COMM_WORLD.Allgather(sendbuff,buffsize,MPI::DOUBLE,
                              recvbuff[0],buffsize,MPI::DOUBLE);
 
    totaltime = MPI::Wtime() - inittime;
+   counters.Stop();
+
+   /*===============================================================*/
+   /* Statistics of totaltime over all the tasks, on task 0.        */
+   stats = ReduceTimings(totaltime,&counters);
 
    /*===============================================================*/
    /* Print out after communication.                                */
@@ -177,7 +186,7 @@ int main(int argc,char** argv)
    if(taskid==0){
      printf("\n");
      printf("##########################################################\n\n");
-     printf(" Communication time : %f seconds\n\n",totaltime);
+     PrintTimings("Communication time",stats);
      printf("##########################################################\n\n");
    }
 
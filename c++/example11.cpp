@@ -79,6 +79,7 @@
 #include <time.h>
 #include <math.h>
 #include <mpi.h>
+#include "mpi_stats.h"
 
 int main(int argc,char** argv)
 {
@@ -88,6 +89,8 @@ int main(int argc,char** argv)
    int          buffsize;
    double       **sendbuff,**recvbuff,buffsum;
    double       inittime,totaltime,recvtime;
+   PerfCounters counters;
+   TimingStats  stats;
 
    /*===============================================================*/
    /* MPI Initialisation. It's important to put this call at the    */
@@ -157,12 +160,18 @@ int main(int argc,char** argv)
    /*===============================================================*/
    /* Communication.                                                */
 
+   counters.Start();
    inittime = MPI::Wtime();
 
    MPI::COMM_WORLD.Alltoall(sendbuff[0],buffsize,MPI::DOUBLE,
                             recvbuff[0],buffsize,MPI::DOUBLE);
 
    totaltime = MPI::Wtime() - inittime;
+   counters.Stop();
+
+   /*===============================================================*/
+   /* Statistics of totaltime over all the tasks, on task 0.        */
+   stats = ReduceTimings(totaltime,&counters);
 
    /*===============================================================*/
    /* Print out after communication.                                */
@@ -193,7 +202,7 @@ int main(int argc,char** argv)
    if(taskid==0){
      printf("\n");
      printf("##########################################################\n\n");
-     printf(" Communication time : %f seconds\n\n",totaltime);
+     PrintTimings("Communication time",stats);
      printf("##########################################################\n\n");
    }
 
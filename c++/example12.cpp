@@ -49,6 +49,58 @@
    Similarly, the function Allreduce does the same work and
    broadcast the reulting vector to all the tasks.
 
+   Iterative solvers call the same reduction thousands of times. An
+   optional mode, given as the second argument, replaces the single
+   Reduce by a loop of niter (third argument, default 10000)
+   iterations, each one computing a new vector and reducing it with
+   Allreduce. The blocking loop is always timed first as reference:
+
+     ireduce    : MPI_Iallreduce is started on one buffer while the
+                  vector of the next iteration is computed in a second
+                  buffer, so computation overlaps communication.
+     persistent : the reduction is planned once with the MPI-4
+                  persistent collective MPI_Allreduce_init (one
+                  request per buffer) and restarted with MPI_Start at
+                  each iteration. Open MPI 4 provides it as
+                  MPIX_Allreduce_init.
+
+   With one task per node and many cores, the local part of the
+   reduction can also be threaded:
+
+     hybrid     : MPI is initialised with MPI::Init_thread
+                  (THREAD_FUNNELED). Each task holds one vector per
+                  thread; a pool of nthreads std::threads sums them
+                  into a single local vector, each thread working on
+                  its own range of elements that it first touched
+                  (so the pages live on its NUMA node). The main
+                  thread then performs the MPI Reduce alone. Running
+                  for example "-np 8 ... hybrid 1" and "-np 1 ...
+                  hybrid 8" on one node compares ranks per node with
+                  threads per rank for the same number of vectors.
+                  Compile with -pthread.
+
+   Many reductions tolerate a reduced precision on the wire. The
+   following modes transfer less bytes and are compared with the
+   double precision Reduce (time, bandwidth, speedup and maximum
+   error relative to the largest element of the reference):
+
+     float      : the vector is sent as MPI::FLOAT and reduced with
+                  MPI::SUM; each step of the reduction tree rounds
+                  its sum to float.
+     bf16       : bfloat16 values (the 16 upper bits of a float)
+                  carried by a committed derived datatype and reduced
+                  with a user operation that adds them as floats and
+                  rounds the sum back to bfloat16.
+     lossy      : error-bounded compression. Each value is quantised
+                  to an integer multiple of 2*tol*max|x|, so that the
+                  error of each contribution is at most tol*max|x|.
+                  The integers are summed exactly by MPI::SUM, as
+                  MPI::SHORT when the bound allows it, else MPI::INT.
+
+   Usage: example12 buffsize [reduce|ireduce|persistent] [niter]
+          example12 buffsize hybrid [nthreads] [niter]
+          example12 buffsize float|bf16|lossy [niter] [tol]
+
  Author: Carol Gauthier
          Francis Jackson (C++ translation)
          Centre de Calcul scientifique
@@ -62,7 +114,33 @@
 #include <stdio.h>
 #include <time.h>
 #include <math.h>
+#include <string.h>
 #include <mpi.h>
+#include "mpi_stats.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <stdint.h>
+#if MPI_VERSION < 4 && defined(OPEN_MPI)
+#include <mpi-ext.h>
+#endif
+
+#if MPI_VERSION >= 4
+#define ALLREDUCE_INIT MPI_Allreduce_init
+#elif defined(OMPI_HAVE_MPI_EXT_PCOLLREQ)
+#define ALLREDUCE_INIT MPIX_Allreduce_init
+#endif
+
+/* Declaration of the functions used by the iterative modes */
+void   ComputeVector ( double* buff, int buffsize, int iter, int taskid );
+double RunBlocking ( int buffsize, int niter, int taskid );
+double RunNonBlocking ( int buffsize, int niter, int taskid );
+double RunPersistent ( int buffsize, int niter, int taskid );
+void   RunHybrid ( int buffsize, int nthreads, int niter, int taskid,
+                   int ntasks, int provided );
+void   RunMixed ( int buffsize, const char* mode, int niter, double tol,
+                  int taskid, int ntasks );
 
 int main(int argc,char** argv)
 {
@@ -72,11 +150,19 @@ int main(int argc,char** argv)
    int          buffsize;
    double       *sendbuff,*recvbuff,buffsum,totalsum;
    double       inittime,totaltime;
+   PerfCounters counters;
+   TimingStats  stats;
+   const char   *mode;
+   int          niter;
+   double       reftime,modetime;
+   int          provided;
 
    /*===============================================================*/
    /* MPI Initialisation. It's important to put this call at the    */
    /* begining of the program, after variable declarations.         */
-   MPI::Init(argc, argv);
+   /* Only the main thread calls MPI, so THREAD_FUNNELED is enough  */
+   /* for the hybrid mode.                                          */
+   provided = MPI::Init_thread(argc, argv, MPI::THREAD_FUNNELED);
 
    /*===============================================================*/
    /* Get the number of MPI tasks and the taskid of this task.      */
@@ -86,6 +172,66 @@ int main(int argc,char** argv)
    /*===============================================================*/
    /* Get buffsize value from program arguments.                    */
    buffsize=atoi(argv[1]);
+   mode = ( argc > 2 ) ? argv[2] : "reduce";
+   niter = ( argc > 3 ) ? atoi(argv[3]) : 10000;
+   if( niter <= 0 ) niter = 10000;
+
+   /*===============================================================*/
+   /* Hybrid mode: threaded local reduction before the network one. */
+   if( strcmp(mode,"hybrid") == 0 ){
+     int nthreads = ( argc > 3 ) ? atoi(argv[3]) : 0;
+     if( nthreads <= 0 ) nthreads = std::thread::hardware_concurrency();
+     if( nthreads <= 0 ) nthreads = 1;
+     niter = ( argc > 4 ) ? atoi(argv[4]) : 100;
+     if( niter <= 0 ) niter = 100;
+     RunHybrid(buffsize,nthreads,niter,taskid,ntasks,provided);
+     MPI::Finalize();
+     return 0;
+   }
+
+   /*===============================================================*/
+   /* Reduced precision modes.                                      */
+   if( strcmp(mode,"float") == 0 || strcmp(mode,"bf16") == 0 ||
+       strcmp(mode,"lossy") == 0 ){
+     double tol = ( argc > 4 ) ? atof(argv[4]) : 1.0e-4;
+     niter = ( argc > 3 ) ? atoi(argv[3]) : 100;
+     if( niter <= 0 ) niter = 100;
+     if( tol <= 0.0 ) tol = 1.0e-4;
+     RunMixed(buffsize,mode,niter,tol,taskid,ntasks);
+     MPI::Finalize();
+     return 0;
+   }
+
+   /*===============================================================*/
+   /* Iterative modes: per-iteration latency of repeated reductions.*/
+   if( strcmp(mode,"ireduce") == 0 || strcmp(mode,"persistent") == 0 ){
+     if ( taskid == 0 ){
+       printf("\n\n\n");
+       printf("##########################################################\n\n");
+       printf(" Example 12 \n\n");
+       printf(" Repeated reduction : %s mode\n\n",mode);
+       printf(" Vector size: %d\n",buffsize);
+       printf(" Number of iterations: %d\n",niter);
+       printf(" Number of tasks: %d\n\n",ntasks);
+       printf("##########################################################\n\n");
+     }
+     reftime = RunBlocking(buffsize,niter,taskid);
+     if( strcmp(mode,"ireduce") == 0 ){
+       modetime = RunNonBlocking(buffsize,niter,taskid);
+     } else {
+       modetime = RunPersistent(buffsize,niter,taskid);
+     }
+     if ( taskid == 0 ){
+       printf(" Blocking Allreduce : %f us per iteration\n",1.0e6*reftime/niter);
+       if( modetime >= 0.0 ){
+         printf(" %-18s : %f us per iteration\n",mode,1.0e6*modetime/niter);
+         printf(" Speedup            : %f\n\n",reftime/modetime);
+       }
+       printf("##########################################################\n\n");
+     }
+     MPI::Finalize();
+     return 0;
+   }
 
    /*===============================================================*/
    /* Printing out the description of the example.                  */
@@ -134,11 +280,17 @@ int main(int argc,char** argv)
    /*===============================================================*/
    /* Communication.                                                */
 
+   counters.Start();
    inittime = MPI::Wtime();
 
    MPI::COMM_WORLD.Reduce(sendbuff,recvbuff,buffsize,MPI::DOUBLE,MPI::SUM,0);
 
    totaltime = MPI::Wtime() - inittime;
+   counters.Stop();
+
+   /*===============================================================*/
+   /* Statistics of totaltime over all the tasks, on task 0.        */
+   stats = ReduceTimings(totaltime,&counters);
 
    /*===============================================================*/
    /* Print out after communication.                                */
@@ -152,7 +304,7 @@ int main(int argc,char** argv)
      printf(" Task %d : Sum of recvbuff elements -> %e \n",taskid,buffsum);
      printf("\n");
      printf("##########################################################\n\n");
-     printf(" Communication time : %f seconds\n\n",totaltime);
+     PrintTimings("Communication time",stats);
      printf("##########################################################\n\n");
    }
 
@@ -167,4 +319,383 @@ int main(int argc,char** argv)
 
 }
 
+/*======================================================================*/
+/* Local work of one iteration: the vector to reduce at iteration iter. */
+void ComputeVector ( double* buff, int buffsize, int iter, int taskid )
+{
+   int i;
+   for(i=0;i<buffsize;i++){
+     buff[i]=sin(0.001*(double)(i+iter+taskid));
+   }
+}
+
+/*======================================================================*/
+/* Reference loop: compute, then reduce with a blocking Allreduce.      */
+double RunBlocking ( int buffsize, int niter, int taskid )
+{
+   int    iter;
+   double *sendbuff,*recvbuff,inittime,totaltime;
+
+   sendbuff = new double[buffsize];
+   recvbuff = new double[buffsize];
+
+   MPI::COMM_WORLD.Barrier();
+   inittime = MPI::Wtime();
+   for(iter=0;iter<niter;iter++){
+     ComputeVector(sendbuff,buffsize,iter,taskid);
+     MPI::COMM_WORLD.Allreduce(sendbuff,recvbuff,buffsize,MPI::DOUBLE,MPI::SUM);
+   }
+   totaltime = MPI::Wtime() - inittime;
+
+   delete [] recvbuff;
+   delete [] sendbuff;
+   return totaltime;
+}
+
+/*======================================================================*/
+/* Overlapped loop: the reduction of iteration iter is in flight while  */
+/* the vector of iteration iter+1 is computed in the other buffer.      */
+double RunNonBlocking ( int buffsize, int niter, int taskid )
+{
+   int         iter,cur;
+   double      *sendbuff[2],*recvbuff[2],inittime,totaltime;
+   MPI_Request request;
+   MPI_Comm    comm = MPI::COMM_WORLD;
+
+   for(cur=0;cur<2;cur++){
+     sendbuff[cur] = new double[buffsize];
+     recvbuff[cur] = new double[buffsize];
+   }
+
+   MPI::COMM_WORLD.Barrier();
+   inittime = MPI::Wtime();
+   cur = 0;
+   ComputeVector(sendbuff[cur],buffsize,0,taskid);
+   for(iter=0;iter<niter;iter++){
+     MPI_Iallreduce(sendbuff[cur],recvbuff[cur],buffsize,MPI_DOUBLE,MPI_SUM,
+                    comm,&request);
+     if( iter+1 < niter ) ComputeVector(sendbuff[1-cur],buffsize,iter+1,taskid);
+     MPI_Wait(&request,MPI_STATUS_IGNORE);
+     cur = 1-cur;
+   }
+   totaltime = MPI::Wtime() - inittime;
+
+   for(cur=0;cur<2;cur++){
+     delete [] recvbuff[cur];
+     delete [] sendbuff[cur];
+   }
+   return totaltime;
+}
+
+/*======================================================================*/
+/* Persistent loop: both reductions are planned once before the loop.  */
+/* Returns a negative time if the MPI library has no persistent         */
+/* collectives.                                                         */
+double RunPersistent ( int buffsize, int niter, int taskid )
+{
+#ifdef ALLREDUCE_INIT
+   int         iter,cur;
+   double      *sendbuff[2],*recvbuff[2],inittime,totaltime;
+   MPI_Request request[2];
+   MPI_Comm    comm = MPI::COMM_WORLD;
+
+   for(cur=0;cur<2;cur++){
+     sendbuff[cur] = new double[buffsize];
+     recvbuff[cur] = new double[buffsize];
+     ALLREDUCE_INIT(sendbuff[cur],recvbuff[cur],buffsize,MPI_DOUBLE,MPI_SUM,
+                    comm,MPI_INFO_NULL,&request[cur]);
+   }
+
+   MPI::COMM_WORLD.Barrier();
+   inittime = MPI::Wtime();
+   cur = 0;
+   ComputeVector(sendbuff[cur],buffsize,0,taskid);
+   for(iter=0;iter<niter;iter++){
+     MPI_Start(&request[cur]);
+     if( iter+1 < niter ) ComputeVector(sendbuff[1-cur],buffsize,iter+1,taskid);
+     MPI_Wait(&request[cur],MPI_STATUS_IGNORE);
+     cur = 1-cur;
+   }
+   totaltime = MPI::Wtime() - inittime;
+
+   for(cur=0;cur<2;cur++){
+     MPI_Request_free(&request[cur]);
+     delete [] recvbuff[cur];
+     delete [] sendbuff[cur];
+   }
+   return totaltime;
+#else
+   if ( taskid == 0 ){
+     printf(" Persistent collectives need an MPI-4 library.\n\n");
+   }
+   return -1.0;
+#endif
+}
+
+/*======================================================================*/
+/* Barrier shared by the threads of the hybrid mode.                    */
+class ThreadBarrier
+{
+  public:
+    ThreadBarrier ( int count ) : count_(count), waiting_(0), phase_(0) {}
+    void Wait ( )
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        int phase = phase_;
+        if( ++waiting_ == count_ ){
+          waiting_ = 0;
+          phase_++;
+          cond_.notify_all();
+        } else {
+          cond_.wait(lock, [&]{ return phase != phase_; });
+        }
+    }
+  private:
+    std::mutex              mutex_;
+    std::condition_variable cond_;
+    int                     count_, waiting_, phase_;
+};
+
+/*======================================================================*/
+/* Hybrid loop. Thread t owns the elements [lo,hi) of every per-thread  */
+/* vector (contrib) and of the local sum (localbuff): it initialises    */
+/* them first, then sums them, so it only reads memory it touched.      */
+/* Thread 0 is the main thread and is the only one calling MPI.         */
+void RunHybrid ( int buffsize, int nthreads, int niter, int taskid,
+                 int ntasks, int provided )
+{
+   double      *contrib,*localbuff,*recvbuff;
+   double      inittime,localtime,commtime,buffsum;
+   ThreadBarrier barrier(nthreads);
+   std::vector<std::thread> pool;
+   int         i;
+
+   if( provided < MPI::THREAD_FUNNELED && taskid == 0 ){
+     printf(" Warning: MPI library does not provide THREAD_FUNNELED\n\n");
+   }
+
+   /* No initialisation here: pages are placed by the first touch.  */
+   contrib   = new double[(size_t)nthreads*buffsize];
+   localbuff = new double[buffsize];
+   recvbuff  = new double[buffsize];
+   localtime = 0.0;
+   commtime  = 0.0;
+
+   auto worker = [&]( int t ){
+     int lo = (int)( (long)buffsize*t/nthreads );
+     int hi = (int)( (long)buffsize*(t+1)/nthreads );
+     int c,k,iter;
+
+     for(c=0;c<nthreads;c++){
+       for(k=lo;k<hi;k++) contrib[(size_t)c*buffsize+k]=0.0;
+     }
+     for(k=lo;k<hi;k++) localbuff[k]=0.0;
+
+     for(iter=0;iter<niter;iter++){
+       /* Each thread produces its part of every contribution. */
+       for(c=0;c<nthreads;c++){
+         double *v = contrib+(size_t)c*buffsize;
+         for(k=lo;k<hi;k++) v[k]=sin(0.001*(double)(k+iter+taskid*nthreads+c));
+       }
+       barrier.Wait();
+       if( t == 0 ) inittime = MPI::Wtime();
+
+       /* Local reduction of the nthreads vectors. */
+       for(k=lo;k<hi;k++) localbuff[k]=contrib[k];
+       for(c=1;c<nthreads;c++){
+         double *v = contrib+(size_t)c*buffsize;
+         for(k=lo;k<hi;k++) localbuff[k]+=v[k];
+       }
+       barrier.Wait();
+
+       /* Network reduction, funneled through the main thread. */
+       if( t == 0 ){
+         localtime += MPI::Wtime() - inittime;
+         inittime = MPI::Wtime();
+         MPI::COMM_WORLD.Reduce(localbuff,recvbuff,buffsize,MPI::DOUBLE,MPI::SUM,0);
+         commtime += MPI::Wtime() - inittime;
+       }
+       barrier.Wait();
+     }
+   };
+
+   MPI::COMM_WORLD.Barrier();
+   for(i=1;i<nthreads;i++) pool.push_back(std::thread(worker,i));
+   worker(0);
+   for(i=0;i<(int)pool.size();i++) pool[i].join();
+
+   if ( taskid == 0 ){
+     buffsum=0.0;
+     for(i=0;i<buffsize;i++) buffsum += recvbuff[i];
+     printf("\n\n\n");
+     printf("##########################################################\n\n");
+     printf(" Example 12 \n\n");
+     printf(" Hybrid reduction : MPI::Init_thread + std::thread\n\n");
+     printf(" Vector size: %d\n",buffsize);
+     printf(" Tasks x threads: %d x %d = %d vectors\n",ntasks,nthreads,
+            ntasks*nthreads);
+     printf(" Number of iterations: %d\n\n",niter);
+     printf(" Sum of recvbuff elements -> %e \n\n",buffsum);
+     printf(" Local reduction : %f us per iteration\n",1.0e6*localtime/niter);
+     printf(" MPI Reduce      : %f us per iteration\n",1.0e6*commtime/niter);
+     printf(" Total           : %f us per iteration\n\n",
+            1.0e6*(localtime+commtime)/niter);
+     printf("##########################################################\n\n");
+   }
+
+   delete [] recvbuff;
+   delete [] localbuff;
+   delete [] contrib;
+}
+
+/*======================================================================*/
+/* bfloat16 conversions: a bfloat16 is the upper half of a float,       */
+/* rounded to nearest even.                                             */
+static inline float Bf16ToFloat ( uint16_t h )
+{
+   uint32_t bits = (uint32_t)h << 16;
+   float    f;
+   memcpy(&f,&bits,sizeof(f));
+   return f;
+}
+
+static inline uint16_t FloatToBf16 ( float f )
+{
+   uint32_t bits;
+   memcpy(&bits,&f,sizeof(bits));
+   bits += 0x7FFF + ( (bits >> 16) & 1 );
+   return (uint16_t)( bits >> 16 );
+}
+
+/*======================================================================*/
+/* User reduction operation of bfloat16: MPI has no bfloat16 type, the  */
+/* values are added as floats and the sum rounded to bfloat16.          */
+void SumBf16 ( const void* in, void* inout, int len, const MPI::Datatype& )
+{
+   const uint16_t *a = (const uint16_t*)in;
+   uint16_t       *b = (uint16_t*)inout;
+   for(int i=0;i<len;i++){
+     b[i] = FloatToBf16( Bf16ToFloat(a[i]) + Bf16ToFloat(b[i]) );
+   }
+}
+
+/*======================================================================*/
+/* Reduced precision Reduce compared with the double precision one.     */
+/* Conversions to and from the wire format are included in the timing. */
+void RunMixed ( int buffsize, const char* mode, int niter, double tol,
+                int taskid, int ntasks )
+{
+   double        *sendbuff,*refbuff,*recvbuff;
+   double        inittime,reftime,modetime,maxabs,globmax,step,err,refmax;
+   void          *wiresend,*wirerecv;
+   int           i,iter,wiresize;
+   MPI::Datatype wiretype;
+   MPI::Op       op = MPI::SUM;
+   bool          userop = false, usertype = false;
+
+   sendbuff = new double[buffsize];
+   refbuff  = new double[buffsize];
+   recvbuff = new double[buffsize];
+   ComputeVector(sendbuff,buffsize,0,taskid);
+   for(i=0;i<buffsize;i++) recvbuff[i]=0.0;
+
+   /* Double precision reference. */
+   MPI::COMM_WORLD.Barrier();
+   inittime = MPI::Wtime();
+   for(iter=0;iter<niter;iter++){
+     MPI::COMM_WORLD.Reduce(sendbuff,refbuff,buffsize,MPI::DOUBLE,MPI::SUM,0);
+   }
+   reftime = ( MPI::Wtime() - inittime ) / niter;
+
+   /* Wire format of the selected mode. */
+   maxabs = 0.0;
+   for(i=0;i<buffsize;i++) if( fabs(sendbuff[i]) > maxabs ) maxabs = fabs(sendbuff[i]);
+   MPI::COMM_WORLD.Allreduce(&maxabs,&globmax,1,MPI::DOUBLE,MPI::MAX);
+   step = ( globmax > 0.0 ) ? 2.0*tol*globmax : 1.0;
+
+   if( strcmp(mode,"float") == 0 ){
+     wiretype = MPI::FLOAT;
+     wiresize = sizeof(float);
+   } else if( strcmp(mode,"bf16") == 0 ){
+     wiretype = MPI::UNSIGNED_SHORT.Create_contiguous(1);
+     wiretype.Commit();
+     wiresize = sizeof(uint16_t);
+     op.Init(SumBf16,true);
+     userop = usertype = true;
+   } else if( ntasks*(globmax/step+0.5) < 32767.0 ){
+     wiretype = MPI::SHORT;
+     wiresize = sizeof(short);
+   } else if( ntasks*(globmax/step+0.5) < 2147483647.0 ){
+     wiretype = MPI::INT;
+     wiresize = sizeof(int);
+   } else {
+     if( taskid == 0 ) printf(" Tolerance %e too small for %d tasks\n\n",tol,ntasks);
+     delete [] recvbuff;
+     delete [] refbuff;
+     delete [] sendbuff;
+     return;
+   }
+   wiresend = new char[(size_t)buffsize*wiresize];
+   wirerecv = new char[(size_t)buffsize*wiresize];
+
+   MPI::COMM_WORLD.Barrier();
+   inittime = MPI::Wtime();
+   for(iter=0;iter<niter;iter++){
+     if( wiretype == MPI::FLOAT ){
+       for(i=0;i<buffsize;i++) ((float*)wiresend)[i] = (float)sendbuff[i];
+     } else if( usertype ){
+       for(i=0;i<buffsize;i++) ((uint16_t*)wiresend)[i] = FloatToBf16((float)sendbuff[i]);
+     } else if( wiretype == MPI::SHORT ){
+       for(i=0;i<buffsize;i++) ((short*)wiresend)[i] = (short)lrint(sendbuff[i]/step);
+     } else {
+       for(i=0;i<buffsize;i++) ((int*)wiresend)[i] = (int)lrint(sendbuff[i]/step);
+     }
+
+     MPI::COMM_WORLD.Reduce(wiresend,wirerecv,buffsize,wiretype,op,0);
+
+     if( taskid == 0 ){
+       if( wiretype == MPI::FLOAT ){
+         for(i=0;i<buffsize;i++) recvbuff[i] = ((float*)wirerecv)[i];
+       } else if( usertype ){
+         for(i=0;i<buffsize;i++) recvbuff[i] = Bf16ToFloat(((uint16_t*)wirerecv)[i]);
+       } else if( wiretype == MPI::SHORT ){
+         for(i=0;i<buffsize;i++) recvbuff[i] = step*((short*)wirerecv)[i];
+       } else {
+         for(i=0;i<buffsize;i++) recvbuff[i] = step*((int*)wirerecv)[i];
+       }
+     }
+   }
+   modetime = ( MPI::Wtime() - inittime ) / niter;
 
+   if ( taskid == 0 ){
+     err = 0.0;
+     refmax = 0.0;
+     for(i=0;i<buffsize;i++){
+       if( fabs(recvbuff[i]-refbuff[i]) > err ) err = fabs(recvbuff[i]-refbuff[i]);
+       if( fabs(refbuff[i]) > refmax ) refmax = fabs(refbuff[i]);
+     }
+     if( refmax > 0.0 ) err /= refmax;
+     printf("\n\n\n");
+     printf("##########################################################\n\n");
+     printf(" Example 12 \n\n");
+     printf(" Reduced precision reduction : %s mode\n\n",mode);
+     printf(" Vector size: %d\n",buffsize);
+     printf(" Number of tasks: %d\n",ntasks);
+     printf(" Bytes per element on the wire: %d\n\n",wiresize);
+     printf(" double : %f us, %f MB/s\n",1.0e6*reftime,
+            buffsize*sizeof(double)/reftime/1.0e6);
+     printf(" %-6s : %f us, %f MB/s\n",mode,1.0e6*modetime,
+            (double)buffsize*wiresize/modetime/1.0e6);
+     printf(" Speedup : %f\n",reftime/modetime);
+     printf(" Max relative error : %e\n\n",err);
+     printf("##########################################################\n\n");
+   }
+
+   if( userop ) op.Free();
+   if( usertype ) wiretype.Free();
+   delete [] (char*)wirerecv;
+   delete [] (char*)wiresend;
+   delete [] recvbuff;
+   delete [] refbuff;
+   delete [] sendbuff;
+}
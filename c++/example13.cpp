@@ -3,11 +3,42 @@
  Example 13 : Creation of process groups
 
  Description:
-   This example shows how to use groups in MPI. To simplify,
-   we fix the number of processors to 8. These processors are
-   separated in two groups. The output gives the rank number
-   of each processor before the separation (from 0 to 7) and
-   after separation (from 0 to 3 for each group).
+   This example shows how to use groups in MPI. The processors
+   are separated in two groups, the first half of the ranks and
+   the second half, for any number of processors. The output
+   gives the rank number of each processor before the separation
+   and after separation.
+
+   Groups of consecutive ranks ignore where the ranks physically
+   live. The second part of the example builds communicators from
+   the machine topology with a small communicator factory:
+
+     node   : ranks sharing memory, MPI_Comm_split_type with
+              MPI_COMM_TYPE_SHARED.
+     socket : ranks of a node running on the same processor
+              package.
+     numa   : ranks of a node running on the same NUMA node.
+
+   The package and NUMA node of the cores in the affinity mask of each
+   rank are read from /sys/devices/system/cpu (Linux only). The ranks
+   must be bound to their cores (mpirun --bind-to core): a rank whose
+   mask spans several packages or NUMA nodes may be moved by the
+   scheduler, so it prints a warning and every rank of its node falls
+   in the same group, as on other systems. The Allreduce latency on the
+   locality-aware groups is then compared with the same number of
+   groups built round-robin (color = rank % ngroups).
+
+   When groups are built inside a loop, Create and Split are paid
+   at each iteration although the result is always the same. The
+   last part of the example uses a communicator cache attached to
+   COMM_WORLD as an attribute (Create_keyval/Set_attr): Split is
+   keyed on the colors and keys of all the ranks and Create on the
+   group membership. The cached communicators are never freed while
+   the cache lives, since a caller may still hold them; they are
+   freed by the attribute delete callback.
+   The cost of Split/Create is compared with cache hits.
+
+   Usage: example13 [node|socket|numa] [niter]
 
    This example has been taken from the URL address:
    http://www.msi.umn.edu/tutorial/MPI
@@ -25,20 +56,79 @@
 
 #include <mpi.h>
 #include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <map>
+#include <vector>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+enum Locality { NODE, SOCKET, NUMA };
+
+/* Declaration of the communicator factory and of the benchmark */
+MPI::Intracomm CreateLocalityComm ( const MPI::Intracomm& comm, Locality level );
+MPI::Intracomm CreateRoundRobinComm ( const MPI::Intracomm& comm, int ngroups );
+double         AllreduceLatency ( const MPI::Intracomm& comm, int niter );
+
+/* Cache of the communicators derived from a parent communicator. The
+   cache is stored as an attribute of the parent, so it lives as long
+   as the parent and any code holding the parent can find it. */
+class CommCache
+{
+  public:
+    /* Cache of the parent communicator, created on first use */
+    static CommCache& Get ( const MPI::Intracomm& parent );
+
+    /* Cached equivalent of parent.Split(color, key). The result
+       depends on the color and key of every rank, so the ranks
+       Allgather them and look up the whole list: one small Allgather
+       instead of a full Split, and the same hit or miss on all. */
+    MPI::Intracomm Split ( int color, int key );
+
+    /* Cached equivalent of parent.Create(group). The group is the
+       same on every rank, so no agreement is needed. */
+    MPI::Intracomm Create ( const MPI::Group& group );
+
+    /* Number of cached communicators */
+    int Size ( ) const { return (int)( splits_.size() + creates_.size() ); }
 
-const int NPROCS=8;
+    /* Keyval of the cache attribute, MPI::KEYVAL_INVALID if unused */
+    static int keyval;
+
+  private:
+    CommCache ( const MPI::Intracomm& parent ) : parent_(parent) {}
+    ~CommCache ( );
+    static int Delete ( MPI::Comm& comm, int keyval, void* value, void* extra );
+
+    MPI::Intracomm                             parent_;
+    std::map<std::vector<int>,MPI::Intracomm>  splits_;
+    std::map<std::vector<int>,MPI::Intracomm>  creates_;
+};
 
 int main(int argc,char** argv)
 {
-  int            rank, new_rank, sendbuf_rank, recvbuf_sum;
-  int            ranks1[4]={0,1,2,3}, ranks2[4]={4,5,6,7};
+  int            rank, nprocs, new_rank, sendbuf_rank, recvbuf_sum;
+  int            nhalf, *ranks1, *ranks2;
   MPI::Group     orig_group, new_group1, new_group2;
   MPI::Intracomm new_comm, new_comm1, new_comm2;
 
   MPI::Init(argc, argv);
   rank = MPI::COMM_WORLD.Get_rank();
+  nprocs = MPI::COMM_WORLD.Get_size();
   sendbuf_rank = rank;
 
+  // The first group holds the first half of the ranks
+  nhalf = ( nprocs + 1 ) / 2;
+  ranks1 = new int[nhalf];
+  ranks2 = new int[nprocs - nhalf + 1];
+  for( int i = 0; i < nprocs; i++ ){
+    if( i < nhalf ) ranks1[i] = i;
+    else            ranks2[i-nhalf] = i;
+  }
+
   //********** With MPI_Comm_create *********
 
   // Extract the original group handle 
@@ -47,8 +137,8 @@ int main(int argc,char** argv)
 
   // Divide tasks into two distinct groups
    
-  new_group1 = orig_group.Incl(NPROCS/2, ranks1);
-  new_group2 = orig_group.Incl(NPROCS/2, ranks2);
+  new_group1 = orig_group.Incl(nhalf, ranks1);
+  new_group2 = orig_group.Incl(nprocs - nhalf, ranks2);
 
   // Create new communicators
 
@@ -56,7 +146,7 @@ int main(int argc,char** argv)
   new_comm2 = MPI::COMM_WORLD.Create( new_group2 );
 
   /* Keep communicatosr different than MPI_COMM_NULL based on the rank */
-  if( rank < NPROCS/2 ){
+  if( rank < nhalf ){
     new_comm = new_comm1;
   } else {
     new_comm = new_comm2;
@@ -72,13 +162,15 @@ int main(int argc,char** argv)
   new_comm.Free();
   new_group1.Free();
   new_group2.Free();
+  delete [] ranks1;
+  delete [] ranks2;
 
 
   // ********** With MPI_Comm_split *********
 
   // Choose the "color" of each process 
   int color;
-  if( rank < NPROCS/2 ){
+  if( rank < nhalf ){
     color = 0;
   } else {
     color = 1;
@@ -97,5 +189,285 @@ int main(int argc,char** argv)
   split_comm.Free();
 
 
+  // ********** Topology-aware communicators *********
+
+  Locality level = NODE;
+  int      niter = 1000;
+  if( argc > 1 && strcmp(argv[1], "socket") == 0 ) level = SOCKET;
+  if( argc > 1 && strcmp(argv[1], "numa") == 0 )   level = NUMA;
+  if( argc > 2 ) niter = atoi(argv[2]);
+  if( niter <= 0 ) niter = 1000;
+
+  MPI::Intracomm local_comm = CreateLocalityComm(MPI::COMM_WORLD, level);
+
+  // Number of groups: one leader (rank 0) per locality communicator
+  int leader = ( local_comm.Get_rank() == 0 ) ? 1 : 0;
+  int ngroups;
+  MPI::COMM_WORLD.Allreduce(&leader, &ngroups, 1, MPI::INT, MPI::SUM);
+
+  MPI::Intracomm rr_comm = CreateRoundRobinComm(MPI::COMM_WORLD, ngroups);
+
+  std::cout << "Locality: rank= "<<rank<<" localrank= "<<local_comm.Get_rank()
+            <<" localsize= "<<local_comm.Get_size()<<'\n';
+
+  double local_time = AllreduceLatency(local_comm, niter);
+  double rr_time    = AllreduceLatency(rr_comm, niter);
+
+  if( rank == 0 ){
+    const char *names[3] = { "node", "socket", "numa" };
+    std::cout << "Allreduce latency over "<<ngroups<<" "<<names[level]
+              <<" groups: locality-aware= "<<1.0e6*local_time
+              <<" us, round-robin= "<<1.0e6*rr_time<<" us" << std::endl;
+  }
+
+  local_comm.Free();
+  rr_comm.Free();
+
+
+  // ********** Cached communicators *********
+
+  int            range[1][3] = { { 0, nhalf - 1, 1 } };
+  double         inittime, times[4], maxtimes[4];
+  MPI::Group     half_group;
+  MPI::Intracomm comm;
+
+  orig_group = MPI::COMM_WORLD.Get_group();
+  half_group = orig_group.Range_incl(1, range);
+
+  // Without cache: the communicator is built and freed at each iteration
+  MPI::COMM_WORLD.Barrier();
+  inittime = MPI::Wtime();
+  for( int i = 0; i < niter; i++ ){
+    comm = MPI::COMM_WORLD.Split(color, rank);
+    comm.Free();
+  }
+  times[0] = ( MPI::Wtime() - inittime ) / niter;
+
+  MPI::COMM_WORLD.Barrier();
+  inittime = MPI::Wtime();
+  for( int i = 0; i < niter; i++ ){
+    comm = MPI::COMM_WORLD.Create(half_group);
+    if( comm != MPI::COMM_NULL ) comm.Free();
+  }
+  times[1] = ( MPI::Wtime() - inittime ) / niter;
+
+  // With cache: only the first iteration builds the communicator,
+  // which stays owned by the cache
+  CommCache& cache = CommCache::Get(MPI::COMM_WORLD);
+
+  MPI::COMM_WORLD.Barrier();
+  inittime = MPI::Wtime();
+  for( int i = 0; i < niter; i++ ){
+    comm = cache.Split(color, rank);
+  }
+  times[2] = ( MPI::Wtime() - inittime ) / niter;
+
+  MPI::COMM_WORLD.Barrier();
+  inittime = MPI::Wtime();
+  for( int i = 0; i < niter; i++ ){
+    comm = cache.Create(half_group);
+  }
+  times[3] = ( MPI::Wtime() - inittime ) / niter;
+
+  MPI::COMM_WORLD.Reduce(times, maxtimes, 4, MPI::DOUBLE, MPI::MAX, 0);
+  if( rank == 0 ){
+    std::cout << "Per call over "<<niter<<" iterations ("<<cache.Size()
+              <<" cached communicators):\n"
+              << "  Split = "<<1.0e6*maxtimes[0]<<" us, cached Split = "
+              <<1.0e6*maxtimes[2]<<" us\n"
+              << "  Create= "<<1.0e6*maxtimes[1]<<" us, cached Create= "
+              <<1.0e6*maxtimes[3]<<" us" << std::endl;
+  }
+
+  // Deleting the attribute frees the cached communicators
+  MPI::COMM_WORLD.Delete_attr(CommCache::keyval);
+  MPI::Comm::Free_keyval(CommCache::keyval);
+  half_group.Free();
+  orig_group.Free();
+
   MPI::Finalize();
+}
+
+int CommCache::keyval = MPI::KEYVAL_INVALID;
+
+// Find the cache attached to parent, or attach a new one
+CommCache& CommCache::Get ( const MPI::Intracomm& parent )
+{
+  CommCache *cache;
+
+  if( keyval == MPI::KEYVAL_INVALID ){
+    keyval = MPI::Comm::Create_keyval(MPI::Comm::NULL_COPY_FN, Delete, NULL);
+  }
+  if( !parent.Get_attr(keyval, &cache) ){
+    cache = new CommCache(parent);
+    parent.Set_attr(keyval, cache);
+  }
+  return *cache;
+}
+
+MPI::Intracomm CommCache::Split ( int color, int key )
+{
+  // The membership is the (color, key) pair of every rank of the parent
+  int              mine[2] = { color, key };
+  std::vector<int> id(2 * parent_.Get_size());
+
+  parent_.Allgather(mine, 2, MPI::INT, &id[0], 2, MPI::INT);
+
+  std::map<std::vector<int>,MPI::Intracomm>::iterator it = splits_.find(id);
+  if( it != splits_.end() ) return it->second;
+
+  MPI::Intracomm comm = parent_.Split(color, key);
+  splits_[id] = comm;
+  return comm;
+}
+
+MPI::Intracomm CommCache::Create ( const MPI::Group& group )
+{
+  // The membership is the list of the group ranks in the parent
+  MPI::Group       parent_group = parent_.Get_group();
+  int              size = group.Get_size();
+  std::vector<int> ranks(size), id(size);
+
+  for( int i = 0; i < size; i++ ) ranks[i] = i;
+  if( size > 0 ){
+    MPI::Group::Translate_ranks(group, size, &ranks[0], parent_group, &id[0]);
+  }
+  parent_group.Free();
+
+  std::map<std::vector<int>,MPI::Intracomm>::iterator it = creates_.find(id);
+  if( it != creates_.end() ) return it->second;
+
+  MPI::Intracomm comm = parent_.Create(group);
+  creates_[id] = comm;
+  return comm;
+}
+
+CommCache::~CommCache ( )
+{
+  std::map<std::vector<int>,MPI::Intracomm>::iterator is, ic;
+
+  for( is = splits_.begin(); is != splits_.end(); ++is ){
+    if( is->second != MPI::COMM_NULL ) is->second.Free();
+  }
+  for( ic = creates_.begin(); ic != creates_.end(); ++ic ){
+    if( ic->second != MPI::COMM_NULL ) ic->second.Free();
+  }
+}
+
+// Attribute delete callback: called when the parent is freed or the
+// attribute deleted
+int CommCache::Delete ( MPI::Comm&, int, void* value, void* )
+{
+  delete (CommCache*) value;
+  return MPI::SUCCESS;
+}
+
+// Read an integer from a file of /sys, -1 if it is not available
+static int ReadSysInt ( const char* path )
+{
+  int   value = -1;
+  FILE *file = fopen(path, "r");
+  if( file != NULL ){
+    if( fscanf(file, "%d", &value) != 1 ) value = -1;
+    fclose(file);
+  }
+  return value;
+}
+
+// Processor package (socket) or NUMA node of a core, -1 if unknown
+static int CpuLocality ( int cpu, Locality level )
+{
+  int  color = -1;
+  char path[256];
+
+  if( level == SOCKET ){
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+    color = ReadSysInt(path);
+  } else {
+    // The cpu directory contains a "nodeN" link to its NUMA node
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR *dir = opendir(path);
+    if( dir != NULL ){
+      struct dirent *entry;
+      while( ( entry = readdir(dir) ) != NULL ){
+        if( strncmp(entry->d_name, "node", 4) == 0 &&
+            sscanf(entry->d_name + 4, "%d", &color) == 1 ) break;
+      }
+      closedir(dir);
+    }
+  }
+  return color;
+}
+
+// Package or NUMA node of this rank: the one holding all the cores of
+// its affinity mask, -1 if the mask spans several of them (the rank is
+// not bound and the scheduler may move it) or if it is unknown
+static int LocalityColor ( Locality level )
+{
+  int color = -1;
+
+#ifdef __linux__
+  cpu_set_t mask;
+
+  CPU_ZERO(&mask);
+  if( sched_getaffinity(0, sizeof(mask), &mask) != 0 ) return -1;
+  for( int cpu = 0; cpu < CPU_SETSIZE; cpu++ ){
+    if( !CPU_ISSET(cpu, &mask) ) continue;
+    int cpucolor = CpuLocality(cpu, level);
+    if( cpucolor < 0 || ( color >= 0 && cpucolor != color ) ) return -1;
+    color = cpucolor;
+  }
+#endif
+  return color;
+}
+
+// Communicator factory: ranks of comm sharing the given locality level.
+// The socket and numa levels need ranks bound to their cores (mpirun
+// --bind-to core): when a rank of a node is not bound inside a single
+// package or NUMA node, the whole node falls back to one group.
+MPI::Intracomm CreateLocalityComm ( const MPI::Intracomm& comm, Locality level )
+{
+  MPI_Comm node_comm;
+  int      rank = comm.Get_rank(), color, mincolor;
+
+  // Split_type is MPI-3 and has no C++ binding: use the C call
+  MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm);
+  MPI::Intracomm node(node_comm);
+  if( level == NODE ) return node;
+
+  color = LocalityColor(level);
+  if( color < 0 ){
+    fprintf(stderr, "Warning: rank %d is not bound to a single %s, run with --bind-to core\n",
+            rank, ( level == SOCKET ) ? "package" : "NUMA node");
+  }
+  node.Allreduce(&color, &mincolor, 1, MPI::INT, MPI::MIN);
+  if( mincolor < 0 ) color = 0;
+
+  MPI::Intracomm local = node.Split(color, rank);
+  node.Free();
+  return local;
+}
+
+// Same number of groups as the factory, ranks dealt round-robin
+MPI::Intracomm CreateRoundRobinComm ( const MPI::Intracomm& comm, int ngroups )
+{
+  int rank = comm.Get_rank();
+  return comm.Split(rank % ngroups, rank);
+}
+
+// Average Allreduce latency on comm, maximum over all the ranks
+double AllreduceLatency ( const MPI::Intracomm& comm, int niter )
+{
+  double sendbuf = 1.0, recvbuf, inittime, time, maxtime;
+
+  comm.Allreduce(&sendbuf, &recvbuf, 1, MPI::DOUBLE, MPI::SUM);
+  MPI::COMM_WORLD.Barrier();
+  inittime = MPI::Wtime();
+  for( int i = 0; i < niter; i++ ){
+    comm.Allreduce(&sendbuf, &recvbuf, 1, MPI::DOUBLE, MPI::SUM);
+  }
+  time = ( MPI::Wtime() - inittime ) / niter;
+  MPI::COMM_WORLD.Allreduce(&time, &maxtime, 1, MPI::DOUBLE, MPI::MAX);
+  return maxtime;
 } 
@@ -1,6 +1,9 @@
 #include "mpi2c++/mpi++.h"
 #include <iostream>
 #include <cstdlib>
+#include <vector>
+#include "mpi_type.h"
+#include "philox.h"
 
 using namespace std;
 
@@ -19,10 +22,79 @@ struct Particule
     double z;
 };
 
+/* Members of the structure, used by mpi_type<Particule>() to build the
+   derived datatype once and keep it in its registry */
+template <> struct FieldList<Particule>
+{
+    static constexpr auto members = make_tuple ( &Particule::species, &Particule::x,
+                                                 &Particule::y, &Particule::z );
+};
+
+/* The same particles stored as a structure of arrays. The four arrays are
+   cut in one single allocation (species first, then x, y and z), so they
+   can be sent either field by field or as one contiguous buffer, and the
+   loops over one coordinate read contiguous memory. */
+struct ParticuleSoA
+{
+  public:
+    ParticuleSoA ( int n );
+    ~ParticuleSoA ( );
+
+    int     n;
+    size_t  bytes;
+    char   *data;
+    int    *species;
+    double *x;
+    double *y;
+    double *z;
+};
+
+/* Domain-decomposed particle store. Instead of replicating every particle
+   on every task, the unit cube is cut in nprocs slabs along x and each task
+   keeps only the particles of its slab. */
+class ParticuleStore
+{
+  public:
+    ParticuleStore ( const MPI::Intracomm& comm );
+
+    /* Task owning the position x */
+    int Owner ( double x ) const;
+
+    /* Each task generates its share of ntotal particles anywhere in the
+       cube (as a parallel reader would read its part of a file), then the
+       particles are sent to their owner with one Alltoallv */
+    void Distribute ( long ntotal );
+
+    /* Moves every particle by at most h in each direction (periodic cube)
+       and exchanges only the particles that left the slab of their task.
+       Returns the number of particles sent by this task. */
+    long Migrate ( double h );
+
+    vector<Particule> local;
+
+  private:
+    /* Sends the particles of send, sorted by owner with the counts
+       sendcounts, and appends the received ones to local */
+    void Exchange ( const vector<Particule>& send, vector<int>& sendcounts );
+
+    MPI::Intracomm comm_;
+    int            rank_, nprocs_;
+};
+
 /* Declaration of the function that is used to build the derived datatype 
    for the preceding structure */
 void BuildMPIParticuleType ( Particule& ptc, MPI::Datatype* MPIParticuleType );
 
+/* Declaration of the function comparing the construction of the datatype
+   with the registry lookup */
+void BenchmarkTypeRegistry ( Particule& ptc, int niter, int myrank );
+
+/* Declaration of the function comparing the AoS and SoA layouts */
+void BenchmarkLayouts ( int maxptc, int myrank );
+
+/* Declaration of the function measuring the throughput of the store */
+void BenchmarkStore ( long ntotal, int nsteps, int myrank );
+
 
 int main( int argc, char **argv )
 {
@@ -61,7 +133,23 @@ int main( int argc, char **argv )
                  << " " << ptc_ptr -> y << " " << ptc_ptr -> z << ")" << endl;
     }
 
+    /* Same transfer with the datatype of the registry: it is built at the
+       first call only, so it can be used in hot loops */
+    MPI::COMM_WORLD.Bcast ( molecules, nombre_ptc, mpi_type<Particule>( ), 0 );
+
+    BenchmarkTypeRegistry ( *molecules, 10000, myrank );
+
+    /* AoS versus SoA, up to maxptc particles (first argument) */
+    BenchmarkLayouts ( ( argc > 1 ) ? atoi ( argv[1] ) : 1000000, myrank );
+
+    /* Distributed store of ntotal particles (second argument) and nsteps
+       migration steps (third argument) */
+    BenchmarkStore ( ( argc > 2 ) ? atol ( argv[2] ) : 1000000,
+                     ( argc > 3 ) ? atoi ( argv[3] ) : 10, myrank );
+
     /* Clean memory */
+    MPIParticuleType.Free( );
+    FreeMpiTypes( );
     delete[] molecules;
     MPI::Finalize( );
 }
@@ -98,3 +186,264 @@ void BuildMPIParticuleType ( Particule& ptc, MPI::Datatype* MPIParticuleType )
     /* It is important after creating a datatype to call the Commit function
        so you can use this datatype */
 }
+
+// Cost of building (and freeing) the datatype at each use compared with
+// a lookup in the registry of mpi_type.h
+void BenchmarkTypeRegistry ( Particule& ptc, int niter, int myrank )
+{
+    MPI::Datatype type;
+    double        inittime, buildtime, lookuptime;
+    MPI::Aint     lb, extent = 0;
+
+    inittime = MPI::Wtime( );
+    for ( int iter = 0; iter < niter; iter++ )
+    {
+        BuildMPIParticuleType ( ptc, &type );
+        type.Free( );
+    }
+    buildtime = ( MPI::Wtime( ) - inittime ) / niter;
+
+    inittime = MPI::Wtime( );
+    for ( int iter = 0; iter < niter; iter++ )
+    {
+        mpi_type<Particule>( ).Get_extent ( lb, extent );
+    }
+    lookuptime = ( MPI::Wtime( ) - inittime ) / niter;
+
+    if ( myrank == 0 )
+    {
+        cout << "extent=" << extent << " (sizeof=" << sizeof ( Particule ) << ")"
+             << ", build+commit=" << 1.0e6 * buildtime << " us"
+             << ", registry lookup=" << 1.0e6 * lookuptime << " us" << endl;
+    }
+}
+
+ParticuleSoA::ParticuleSoA ( int n ) : n ( n )
+{
+    /* x, y and z stay aligned on 8 bytes after the species */
+    size_t nspecies = ( (size_t) n * sizeof ( int ) + 7 ) / 8 * 8;
+    bytes = nspecies + 3 * (size_t) n * sizeof ( double );
+    data = new char[ bytes ];
+    species = (int*) data;
+    x = (double*) ( data + nspecies );
+    y = x + n;
+    z = y + n;
+}
+
+ParticuleSoA::~ParticuleSoA ( )
+{
+    delete[] data;
+}
+
+// Transfer and position update of n = 1e3 .. maxptc particles with the
+// array of structures (one Bcast of the derived datatype) and with the
+// structure of arrays (four Bcasts, one per field, or one Bcast of the
+// whole contiguous allocation)
+void BenchmarkLayouts ( int maxptc, int myrank )
+{
+    const double dx = 1.0e-3, dy = 2.0e-3, dz = 3.0e-3;
+    double       inittime, aos_bcast, soa_fields, soa_single, aos_move, soa_move;
+
+    /* The contiguous allocation is sent in words of 8 bytes, so that the
+       count stays below 2^31 up to 1e8 particles */
+    MPI::Datatype word = MPI::BYTE.Create_contiguous ( 8 );
+    word.Commit( );
+
+    if ( myrank == 0 )
+    {
+        cout << "nptc  AoS Bcast  SoA Bcast/field  SoA Bcast/single  AoS move  SoA move (ms)"
+             << endl;
+    }
+    for ( long n = 1000; n <= maxptc; n *= 10 )
+    {
+        Particule   *aos = new Particule[ n ];
+        ParticuleSoA soa ( n );
+
+        for ( int i = 0; i < n; i++ )
+        {
+            aos[i].species = soa.species[i] = ( int ) H2;
+            aos[i].x = soa.x[i] = ( (double) rand( ) ) / RAND_MAX;
+            aos[i].y = soa.y[i] = ( (double) rand( ) ) / RAND_MAX;
+            aos[i].z = soa.z[i] = ( (double) rand( ) ) / RAND_MAX;
+        }
+
+        MPI::COMM_WORLD.Barrier( );
+        inittime = MPI::Wtime( );
+        MPI::COMM_WORLD.Bcast ( aos, n, mpi_type<Particule>( ), 0 );
+        aos_bcast = MPI::Wtime( ) - inittime;
+
+        MPI::COMM_WORLD.Barrier( );
+        inittime = MPI::Wtime( );
+        MPI::COMM_WORLD.Bcast ( soa.species, n, MPI::INT, 0 );
+        MPI::COMM_WORLD.Bcast ( soa.x, n, MPI::DOUBLE, 0 );
+        MPI::COMM_WORLD.Bcast ( soa.y, n, MPI::DOUBLE, 0 );
+        MPI::COMM_WORLD.Bcast ( soa.z, n, MPI::DOUBLE, 0 );
+        soa_fields = MPI::Wtime( ) - inittime;
+
+        MPI::COMM_WORLD.Barrier( );
+        inittime = MPI::Wtime( );
+        MPI::COMM_WORLD.Bcast ( soa.data, soa.bytes / 8, word, 0 );
+        soa_single = MPI::Wtime( ) - inittime;
+
+        /* Move every particle; the SoA loops are unit-stride and
+           vectorised by the compiler */
+        inittime = MPI::Wtime( );
+        for ( int i = 0; i < n; i++ )
+        {
+            aos[i].x += dx;
+            aos[i].y += dy;
+            aos[i].z += dz;
+        }
+        aos_move = MPI::Wtime( ) - inittime;
+
+        inittime = MPI::Wtime( );
+        double *x = soa.x, *y = soa.y, *z = soa.z;
+        for ( int i = 0; i < n; i++ ) x[i] += dx;
+        for ( int i = 0; i < n; i++ ) y[i] += dy;
+        for ( int i = 0; i < n; i++ ) z[i] += dz;
+        soa_move = MPI::Wtime( ) - inittime;
+
+        if ( myrank == 0 )
+        {
+            cout << n << "  " << 1.0e3 * aos_bcast << "  " << 1.0e3 * soa_fields
+                 << "  " << 1.0e3 * soa_single << "  " << 1.0e3 * aos_move
+                 << "  " << 1.0e3 * soa_move << endl;
+        }
+        delete[] aos;
+    }
+    word.Free( );
+}
+
+ParticuleStore::ParticuleStore ( const MPI::Intracomm& comm ) : comm_ ( comm )
+{
+    rank_ = comm.Get_rank( );
+    nprocs_ = comm.Get_size( );
+}
+
+int ParticuleStore::Owner ( double x ) const
+{
+    int owner = ( int ) ( x * nprocs_ );
+    if ( owner < 0 ) owner = 0;
+    if ( owner >= nprocs_ ) owner = nprocs_ - 1;
+    return owner;
+}
+
+void ParticuleStore::Distribute ( long ntotal )
+{
+    long              nlocal = ntotal / nprocs_ + ( rank_ < ntotal % nprocs_ ? 1 : 0 );
+    vector<Particule> generated ( nlocal ), send ( nlocal );
+    vector<int>       sendcounts ( nprocs_, 0 ), offsets ( nprocs_, 0 );
+    vector<double>    coord ( 3 * nlocal );
+
+    /* The coordinates of the task are the stream rank_ of philox.h, drawn
+       in one batch: x, then y, then z */
+    Philox ( 15, rank_ ).Uniform ( 0, coord.size( ), coord.data( ) );
+    for ( long i = 0; i < nlocal; i++ )
+    {
+        generated[i].species = ( int ) H2;
+        generated[i].x = coord[i];
+        generated[i].y = coord[nlocal + i];
+        generated[i].z = coord[2 * nlocal + i];
+        sendcounts[ Owner ( generated[i].x ) ]++;
+    }
+
+    /* Counting sort by owner */
+    for ( int p = 1; p < nprocs_; p++ ) offsets[p] = offsets[p-1] + sendcounts[p-1];
+    for ( long i = 0; i < nlocal; i++ ) send[ offsets[ Owner ( generated[i].x ) ]++ ] = generated[i];
+
+    local.clear( );
+    Exchange ( send, sendcounts );
+}
+
+long ParticuleStore::Migrate ( double h )
+{
+    vector<Particule> leaving;
+    vector<int>       sendcounts ( nprocs_, 0 ), offsets ( nprocs_, 0 );
+    size_t            kept = 0;
+
+    /* Move, and keep the particles still in the slab at the front */
+    for ( size_t i = 0; i < local.size( ); i++ )
+    {
+        Particule& p = local[i];
+        p.x += h * ( 2.0 * rand( ) / RAND_MAX - 1.0 );
+        p.y += h * ( 2.0 * rand( ) / RAND_MAX - 1.0 );
+        p.z += h * ( 2.0 * rand( ) / RAND_MAX - 1.0 );
+        p.x -= ( p.x >= 1.0 ) ? 1.0 : ( p.x < 0.0 ) ? -1.0 : 0.0;
+        p.y -= ( p.y >= 1.0 ) ? 1.0 : ( p.y < 0.0 ) ? -1.0 : 0.0;
+        p.z -= ( p.z >= 1.0 ) ? 1.0 : ( p.z < 0.0 ) ? -1.0 : 0.0;
+        if ( Owner ( p.x ) == rank_ )
+        {
+            local[kept++] = p;
+        }
+        else
+        {
+            leaving.push_back ( p );
+            sendcounts[ Owner ( p.x ) ]++;
+        }
+    }
+    local.resize ( kept );
+
+    vector<Particule> send ( leaving.size( ) );
+    for ( int p = 1; p < nprocs_; p++ ) offsets[p] = offsets[p-1] + sendcounts[p-1];
+    for ( size_t i = 0; i < leaving.size( ); i++ ) send[ offsets[ Owner ( leaving[i].x ) ]++ ] = leaving[i];
+
+    Exchange ( send, sendcounts );
+    return ( long ) leaving.size( );
+}
+
+void ParticuleStore::Exchange ( const vector<Particule>& send, vector<int>& sendcounts )
+{
+    vector<int> recvcounts ( nprocs_ ), sdispls ( nprocs_, 0 ), rdispls ( nprocs_, 0 );
+    size_t      old = local.size( );
+
+    comm_.Alltoall ( &sendcounts[0], 1, MPI::INT, &recvcounts[0], 1, MPI::INT );
+    for ( int p = 1; p < nprocs_; p++ )
+    {
+        sdispls[p] = sdispls[p-1] + sendcounts[p-1];
+        rdispls[p] = rdispls[p-1] + recvcounts[p-1];
+    }
+    local.resize ( old + rdispls[nprocs_-1] + recvcounts[nprocs_-1] );
+
+    /* The datatype of the registry is not rebuilt at each exchange */
+    comm_.Alltoallv ( send.empty( ) ? NULL : &send[0], &sendcounts[0], &sdispls[0],
+                      mpi_type<Particule>( ),
+                      local.size( ) == old ? NULL : &local[old], &recvcounts[0], &rdispls[0],
+                      mpi_type<Particule>( ) );
+}
+
+// Throughput of the initial distribution and of the migration steps, in
+// particles per second over all the tasks
+void BenchmarkStore ( long ntotal, int nsteps, int myrank )
+{
+    ParticuleStore store ( MPI::COMM_WORLD );
+    double         inittime, disttime, migtime = 0.0;
+    long           nlocal, nglobal, nsent = 0, nsentglob;
+
+    MPI::COMM_WORLD.Barrier( );
+    inittime = MPI::Wtime( );
+    store.Distribute ( ntotal );
+    disttime = MPI::Wtime( ) - inittime;
+
+    for ( int step = 0; step < nsteps; step++ )
+    {
+        MPI::COMM_WORLD.Barrier( );
+        inittime = MPI::Wtime( );
+        nsent += store.Migrate ( 0.01 );
+        migtime += MPI::Wtime( ) - inittime;
+    }
+
+    nlocal = ( long ) store.local.size( );
+    MPI::COMM_WORLD.Reduce ( &nlocal, &nglobal, 1, MPI::LONG, MPI::SUM, 0 );
+    MPI::COMM_WORLD.Reduce ( &nsent, &nsentglob, 1, MPI::LONG, MPI::SUM, 0 );
+    if ( myrank == 0 )
+    {
+        cout << "Store of " << nglobal << " particles: distribution "
+             << ntotal / disttime << " ptc/s";
+        if ( nsteps > 0 )
+        {
+            cout << ", migration " << ( double ) ntotal * nsteps / migtime << " ptc/s ("
+                 << 100.0 * nsentglob / ( ( double ) ntotal * nsteps ) << "% moved)";
+        }
+        cout << endl;
+    }
+}
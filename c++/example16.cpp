@@ -11,6 +11,110 @@
    as a slave processor is done with a task, it contacts the master
    to receive a new task.
 
+   A task is a chunk of consecutive volumes {first, count}; the slave
+   answers with the number of particles of the whole chunk. The size
+   of the chunks is chosen by the scheduler of the master:
+
+     single    : one volume per message (default).
+     guided    : guided self-scheduling, each chunk is the remaining
+                 number of volumes divided by the number of slaves.
+     factoring : the volumes are given by batches; each batch shares
+                 half of the remaining volumes in nslaves equal chunks.
+
+   The chunks shrink as the remaining work shrinks, so the master
+   sends few large messages at the beginning and small ones at the
+   end to keep the load balanced. The master reports the makespan,
+   the number of messages per second and its busy fraction (the time
+   it does not spend waiting in Waitany).
+
+   In the rma mode there is no master: the index of the next volume
+   lives in an MPI window on rank 0 and every rank, rank 0 included,
+   claims the next chunk of volumes with MPI_Fetch_and_op under a
+   passive target lock (MPI_Win_lock_all). The assignment latency
+   (time to claim a chunk) is reported for this mode and for the
+   slaves of the master modes.
+
+   With thousands of slaves every message lands on rank 0. The tree
+   mode puts a sub-master between the root and the slaves: the slaves
+   are grouped by node (MPI_Comm_split_type) or by groups of gsize
+   consecutive ranks, the first rank of each group is its
+   sub-master. The sub-masters pull large batches from the root
+   (factoring over the sub-masters) and hand them out one volume at a
+   time to the slaves of their group, which run the same loop as in
+   the flat mode on the group communicator.
+
+   The steal mode needs neither master nor shared counter. Each rank
+   owns a deque of volume indices, first a block of nvol/nprocs
+   volumes. It takes its tasks at the front of its deque; when the
+   deque is empty it asks a random victim, which answers with the back
+   half of its remaining volumes. Termination is detected by a token
+   going around the ring of ranks and summing the number of completed
+   volumes; an idle rank forwards the token, and rank 0 sends the end
+   message when the sum reaches nvol. The volumes of the first eighth
+   cost skew times more, and the makespan is compared with the static
+   block distribution of the same volumes.
+
+   In the modes above a slave sends its result and then waits a full
+   round trip for its next task. In the prefetch mode the master keeps
+   depth tasks queued ahead for each slave: it pre-sends depth tasks
+   and one more for each result. The slave posts the Irecv of the
+   following tasks before computing the current one, so the next task
+   is usually there when it finishes. An artificial latency (in
+   microseconds) emulates a slow network on the receiving side: each
+   task carries the time it was sent, and the slave does not use it
+   before that time plus the latency, so the master is never slowed
+   down. The clocks are matched by a few ping-pongs before the run.
+   Each slave reports its idle time.
+
+   By default the master takes the results one at a time with
+   Waitany, which scans the nslaves requests at every call. With the
+   some option it uses Waitsome: every result arrived is handled in
+   one sweep, the next tasks are sent and the receives re-armed
+   together before waiting again. The master reports the number of
+   results per wait and its cost per result outside the waits.
+
+   Usage: example16 [nvol] [single|guided|factoring] [any|some]
+          example16 [nvol] rma [chunk]
+          example16 [nvol] tree [gsize]
+          example16 [nvol] steal [skew]
+          example16 [nvol] prefetch [depth] [latency]
+          example16 [nvol] rng
+          example16 [nvol] store [batch] [nbins]
+          example16 [nvol] threads [nthreads] [chunk]
+
+   In the store mode the particles are kept instead of being counted
+   only. Each slave appends them to an arena of batch particles, two
+   arenas being allocated once: while one is sent to the master with
+   an Isend the other is filled. The master has one Irecv per slave
+   for the results and one more from MPI::ANY_SOURCE for the batches
+   of particles. The slaves histogram the distance of their particles
+   to the origin, and the global histogram is obtained with a single
+   Reduce. The master reports the end-to-end rate in particles/s.
+
+   With one rank per core every core talks to the master. In the
+   threads mode each slave rank runs a pool of nthreads std::threads
+   that take volume indices from a local queue, and its main thread is
+   the only one talking to the master: it asks for a chunk of chunk
+   volumes (2*nthreads by default) as soon as fewer than nthreads
+   volumes are waiting in the queue, so the pool rarely starves. Each
+   request carries the particles of the volumes completed since the
+   previous one, and a last message reports the rest. MPI is
+   initialised with Init_thread asking for THREAD_MULTIPLE; since only
+   the main thread calls MPI, THREAD_FUNNELED is enough. Running
+   "threads 1" with one rank per core and "threads ncores" with one
+   rank per node compares the messages and the throughput of both.
+   Compile with -pthread.
+
+   The single, guided and factoring modes are traced with mpi_trace.h
+   when MPI_TRACE names the output file: waits and assignments of the
+   master, generation and requests of the slaves.
+
+   The particles of volume ivol are drawn from the stream ivol of a
+   counter-based generator (philox.h), so the particles, and the total
+   reported by the master, do not depend on the scheduling or on the
+   number of tasks. The rng mode compares its rate with rand() on
+   every rank.
+
  Auteur: Steve Allen
          Centre de Calcul scientifique
          Universite de Sherbrooke
@@ -22,113 +126,1190 @@
 #include "mpi2c++/mpi++.h"
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "philox.h"
+#include "mpi_trace.h"
+
+enum Scheduler { SINGLE, GUIDED, FACTORING, RMA, TREE, STEAL, PREFETCH, RNG, STORE, THREADS };
+
+/* Declaration of the functions of the master and of the slaves */
+int  GenerateVolume ( int ivol );
+int  GenerateVolumeRand ( int );
+void BenchmarkRng ( int nvol, int myrank );
+int  NextChunk ( Scheduler scheduler, int remaining, int nslaves,
+                 int& batch_left, int& batch_chunk );
+void RunMaster ( int nvol, int nslaves, Scheduler scheduler, bool sweep );
+long RunSlave ( const MPI::Intracomm& comm );
+void RunRma ( int nvol, int chunk, int myrank, int nprocs );
+void RunTree ( int nvol, int gsize, int myrank );
+void RunTreeRoot ( int nvol, int nsub );
+long RunSubMaster ( const MPI::Intracomm& local );
+long RunSkewedVolume ( int ivol, int nvol, int skew );
+void RunStealing ( int nvol, int skew, int myrank, int nprocs, bool steal );
+void RunPrefetchMaster ( int nvol, int nslaves, int depth, double latency );
+void RunPrefetchSlave ( int myrank, int depth, double latency );
+void RunStoreMaster ( int nvol, int nslaves, int batch, int nbins );
+void RunStoreSlave ( int myrank, int batch, int nbins );
+void RunThreadsMaster ( int nvol, int nslaves, int chunk );
+void RunThreadsSlave ( int myrank, int nthreads );
+
+const int finish_flag = -1;
+
+/* Seed of the particle streams, and the last volume generated by the
+   calling thread */
+const uint64_t seed = 16;
+struct VolumeBuffer { std::vector<float> x, y, z; };
+thread_local VolumeBuffer volume;
+
+/* Tags of the messages between the root and the sub-masters */
+const int tag_request = 1, tag_batch = 2;
+
+/* Tags of the messages of the work-stealing mode */
+const int tag_steal = 10, tag_loot = 11, tag_token = 12, tag_done = 13;
+
+/* Tag of the batches of particles of the store mode */
+const int tag_store = 14;
+
+/* Tag of the clock ping-pongs of the prefetch mode */
+const int tag_clock = 15;
+const int nclock = 10;
 
 int main( int argc,char* argv[] )
 {
    int          master = 0;
-   int          finish_flag = -1;
    int          myrank, nprocs;
-   int          nvol, nptc, totptc;
-   int          i, nfinish, *buf_recv, nslaves, last;
-   float        x, y, z;
-   MPI::Request *request;
+   int          nvol;
+   int          provided = MPI::THREAD_SINGLE;
+   Scheduler    scheduler = SINGLE;
 
-   /* Initialisation */
-   MPI::Init( argc, argv );
+   /* Initialisation: the threads mode needs a threaded MPI */
+   if( argc > 2 && strcmp( argv[2], "threads" ) == 0 )
+   {
+      scheduler = THREADS;
+      provided = MPI::Init_thread( argc, argv, MPI::THREAD_MULTIPLE );
+   }
+   else
+   {
+      MPI::Init( argc, argv );
+   }
    myrank = MPI::COMM_WORLD.Get_rank( );
    nprocs = MPI::COMM_WORLD.Get_size( );
+   TraceInit( );
+
+   if( argc > 2 && strcmp( argv[2], "guided" ) == 0 ) scheduler = GUIDED;
+   if( argc > 2 && strcmp( argv[2], "factoring" ) == 0 ) scheduler = FACTORING;
+   if( argc > 2 && strcmp( argv[2], "rma" ) == 0 ) scheduler = RMA;
+   if( argc > 2 && strcmp( argv[2], "tree" ) == 0 ) scheduler = TREE;
+   if( argc > 2 && strcmp( argv[2], "steal" ) == 0 ) scheduler = STEAL;
+   if( argc > 2 && strcmp( argv[2], "prefetch" ) == 0 ) scheduler = PREFETCH;
+   if( argc > 2 && strcmp( argv[2], "rng" ) == 0 ) scheduler = RNG;
+   if( argc > 2 && strcmp( argv[2], "store" ) == 0 ) scheduler = STORE;
 
-   /* The number of cpus must at least be two */
-   if( nprocs < 2 )
+   nvol = 0;
+   if( argc > 1 )
+   {
+       nvol = atoi( argv[1] );
+   }
+   if( nvol <= 0 ) nvol = 6000;
+
+   /* The number of cpus must at least be two, except without master */
+   if( nprocs < 2 && scheduler != RMA && scheduler != STEAL && scheduler != RNG )
    {
        std::cout << nprocs << " cpus is not enough for this example" << std::endl;
        MPI::Finalize();
        exit( 1 );
     }
 
-   nvol = 0;
-   if (myrank == master)
+   if( scheduler == RMA )
+   {
+      /* Every rank works */
+      RunRma( nvol, ( argc > 3 ) ? atoi( argv[3] ) : 1, myrank, nprocs );
+   }
+   else if( scheduler == TREE )
+   {
+      /* Root, sub-masters and slaves */
+      RunTree( nvol, ( argc > 3 ) ? atoi( argv[3] ) : 0, myrank );
+   }
+   else if( scheduler == STEAL )
+   {
+      /* Static blocks first, then the same blocks with stealing */
+      int skew = ( argc > 3 ) ? atoi( argv[3] ) : 8;
+      RunStealing( nvol, skew, myrank, nprocs, false );
+      RunStealing( nvol, skew, myrank, nprocs, true );
+   }
+   else if( scheduler == RNG )
+   {
+      BenchmarkRng( nvol, myrank );
+   }
+   else if( scheduler == THREADS )
+   {
+      int nthreads = ( argc > 3 ) ? atoi( argv[3] ) : 0;
+      if( nthreads <= 0 ) nthreads = std::thread::hardware_concurrency( );
+      if( nthreads <= 0 ) nthreads = 1;
+      int chunk = ( argc > 4 ) ? atoi( argv[4] ) : 2 * nthreads;
+      if( chunk <= 0 ) chunk = 2 * nthreads;
+      if( provided < MPI::THREAD_FUNNELED )
+      {
+         if( myrank == master ) std::cout << "MPI provides no thread support" << std::endl;
+         MPI::Finalize();
+         exit( 1 );
+      }
+      if( myrank == master )
+         RunThreadsMaster( nvol, nprocs - 1, chunk );
+      else
+         RunThreadsSlave( myrank, nthreads );
+   }
+   else if( scheduler == STORE )
+   {
+      int batch = ( argc > 3 ) ? atoi( argv[3] ) : 65536;
+      int nbins = ( argc > 4 ) ? atoi( argv[4] ) : 10;
+      if( batch < 1 ) batch = 65536;
+      if( nbins < 1 ) nbins = 10;
+      if( myrank == master )
+         RunStoreMaster( nvol, nprocs - 1, batch, nbins );
+      else
+         RunStoreSlave( myrank, batch, nbins );
+   }
+   else if( scheduler == PREFETCH )
+   {
+      int depth = ( argc > 3 ) ? atoi( argv[3] ) : 2;
+      double latency = ( argc > 4 ) ? atof( argv[4] ) : 0.0;
+      if( depth < 1 ) depth = 1;
+      if( myrank == master )
+         RunPrefetchMaster( nvol, nprocs - 1, depth, latency );
+      else
+         RunPrefetchSlave( myrank, depth, latency );
+   }
+   else if (myrank == master)
    {
-
       /* Tasks of the master */
-      if( argc > 1 )
+      RunMaster( nvol, nprocs - 1, scheduler,
+                 argc > 3 && strcmp( argv[3], "some" ) == 0 );
+   } else {
+      /* Tasks for slaves */
+      RunSlave( MPI::COMM_WORLD );
+   }
+
+   TraceFinalize( );
+   MPI::COMM_WORLD.Barrier( );
+   MPI::Finalize();
+}
+
+/* Doing a task: Generating a list of particles positions for the volume
+   ivol. Returns the number of particles. */
+int GenerateVolume ( int ivol )
+{
+   Philox rng( seed, ivol );
+   float  u;
+   int    nptc;
+
+   /* Value 0 of the stream gives the number of particles, then come
+      the nptc values of x, of y and of z */
+   rng.Uniform( 0, 1, &u );
+   nptc = (int) ( u * 2500 ) + 2500;
+   volume.x.resize( nptc );
+   volume.y.resize( nptc );
+   volume.z.resize( nptc );
+   rng.Uniform( 1, nptc, volume.x.data( ) );
+   rng.Uniform( 1 + nptc, nptc, volume.y.data( ) );
+   rng.Uniform( 1 + 2 * (uint64_t) nptc, nptc, volume.z.data( ) );
+   return nptc;
+}
+
+/* The former generator: three calls of rand() per particle */
+int GenerateVolumeRand ( int )
+{
+   int   i, nptc;
+
+   nptc = (int) ( ( (float) rand() ) / RAND_MAX * 2500 ) + 2500;
+   volume.x.resize( nptc );
+   volume.y.resize( nptc );
+   volume.z.resize( nptc );
+   for( i = 0; i < nptc; i++ )
+   {
+      volume.x[i] = ( (float) rand() ) / RAND_MAX;
+      volume.y[i] = ( (float) rand() ) / RAND_MAX;
+      volume.z[i] = ( (float) rand() ) / RAND_MAX;
+   }
+   return nptc;
+}
+
+/* Rate of both generators on each rank. Every rank draws the same nvol
+   volumes; with philox.h they are identical on every rank. */
+void BenchmarkRng ( int nvol, int myrank )
+{
+   long   nptc[2] = { 0, 0 };
+   double rate[2], minrate[2], maxrate[2], inittime, sum = 0.0, minsum, maxsum;
+
+   inittime = MPI::Wtime( );
+   for( int ivol = 0; ivol < nvol; ivol++ ) nptc[0] += GenerateVolumeRand( ivol );
+   rate[0] = nptc[0] / ( MPI::Wtime( ) - inittime );
+
+   inittime = MPI::Wtime( );
+   for( int ivol = 0; ivol < nvol; ivol++ )
+   {
+      nptc[1] += GenerateVolume( ivol );
+      sum += volume.x[0] + volume.y[0] + volume.z[0];
+   }
+   rate[1] = nptc[1] / ( MPI::Wtime( ) - inittime );
+
+   MPI::COMM_WORLD.Reduce( rate, minrate, 2, MPI::DOUBLE, MPI::MIN, 0 );
+   MPI::COMM_WORLD.Reduce( rate, maxrate, 2, MPI::DOUBLE, MPI::MAX, 0 );
+   MPI::COMM_WORLD.Reduce( &sum, &minsum, 1, MPI::DOUBLE, MPI::MIN, 0 );
+   MPI::COMM_WORLD.Reduce( &sum, &maxsum, 1, MPI::DOUBLE, MPI::MAX, 0 );
+   if( myrank == 0 )
+   {
+      std::cout << "rand()  : "<<nptc[0]<<" ptcs, "<<minrate[0]<<" - "<<maxrate[0]
+                << " ptcs/s per rank"<<std::endl;
+      std::cout << "philox  : "<<nptc[1]<<" ptcs, "<<minrate[1]<<" - "<<maxrate[1]
+                << " ptcs/s per rank, speedup "<<rate[1]/rate[0]<<std::endl;
+      std::cout << "Same volumes on every rank: "<<( minsum == maxsum ? "yes" : "no" )<<std::endl;
+   }
+}
+
+/* Size of the next chunk given the number of remaining volumes.
+   batch_left and batch_chunk hold the state of the factoring batches. */
+int NextChunk ( Scheduler scheduler, int remaining, int nslaves,
+                int& batch_left, int& batch_chunk )
+{
+   int chunk = 1;
+
+   if( scheduler == GUIDED )
+   {
+      chunk = ( remaining + nslaves - 1 ) / nslaves;
+   }
+   else if( scheduler == FACTORING )
+   {
+      if( batch_left == 0 )
       {
-          nvol = atoi( argv[1] );
+         /* New batch: half of the remaining work in nslaves chunks */
+         batch_chunk = ( remaining + 2 * nslaves - 1 ) / ( 2 * nslaves );
+         batch_left = nslaves;
       }
-      if( nvol <= 0 ) nvol = 6000;
-      nslaves = nprocs - 1;
-      std::cout << "Generating nvol="<<nvol<<" with "<<nslaves<<" procs"<<std::endl;
+      batch_left--;
+      chunk = batch_chunk;
+   }
+   if( chunk < 1 ) chunk = 1;
+   if( chunk > remaining ) chunk = remaining;
+   return chunk;
+}
+
+void RunMaster ( int nvol, int nslaves, Scheduler scheduler, bool sweep )
+{
+   const char   *names[3] = { "single", "guided", "factoring" };
+   int          i, k, ndone, nfinish, *buf_recv, *indices, last, task[2];
+   int          batch_left = 0, batch_chunk = 0;
+   long         nmsg = 0, nresult = 0, nwait = 0, totptc = 0;
+   double       inittime, waittime = 0.0, waitstart, makespan;
+   MPI::Request *request;
+
+   std::cout << "Generating nvol="<<nvol<<" with "<<nslaves<<" procs ("
+             << names[scheduler] << " scheduler, "<<( sweep ? "Waitsome" : "Waitany" )
+             << ")"<<std::endl;
 
-      buf_recv = new int[ nslaves ];
-      request = new MPI::Request[ nslaves ];
-      last = 0;
-      nfinish = 0;
+   buf_recv = new int[ nslaves ];
+   indices = new int[ nslaves ];
+   request = new MPI::Request[ nslaves ];
+   last = 0;
+   nfinish = 0;
+   inittime = MPI::Wtime();
 
-      /* Sending the first tasks to each slaves */
-      for( i = 0; i < nslaves; i++ )
+   /* Sending the first tasks to each slaves */
+   for( i = 0; i < nslaves; i++ )
+   {
+      if( last < nvol )
       {
-         if( last < nvol )
+         task[0] = last;
+         task[1] = NextChunk( scheduler, nvol - last, nslaves, batch_left, batch_chunk );
+         last += task[1];
+         MPI::COMM_WORLD.Send( task, 2, MPI::INT, i+1, 0 );
+         request[i] = MPI::COMM_WORLD.Irecv( &(buf_recv[i]), 1, MPI::INT, i+1, i+1 );
+      }
+      else
+      {
+         task[0] = finish_flag;
+         MPI::COMM_WORLD.Send( task, 2, MPI::INT, i+1, 0 );
+         nfinish++;
+      }
+      nmsg++;
+   }
+   while( nfinish < nslaves )
+   {
+      /* Waiting for any cpus to be done, or for all those done */
+      waitstart = MPI::Wtime();
+      {
+         TraceScope trace( sweep ? "Waitsome" : "Waitany" );
+         if( sweep )
          {
-            last++;
-            MPI::COMM_WORLD.Send( &last, 1, MPI::INT, i+1, 0 );
-            request[i] = MPI::COMM_WORLD.Irecv( &(buf_recv[i]), 1, MPI::INT, i+1, i+1 );
+            ndone = MPI::Request::Waitsome( nslaves, request, indices );
          }
          else
          {
-            MPI::COMM_WORLD.Send( &finish_flag, 1, MPI::INT, i+1, 0 );
-            nfinish++;
+            indices[0] = MPI::Request::Waitany( nslaves, request );
+            ndone = 1;
          }
       }
-      while( nfinish < nslaves )
+      waittime += MPI::Wtime() - waitstart;
+      nwait++;
+
+      for( k = 0; k < ndone; k++ )
       {
-         /* Waiting for any cpus to be done */
-         i = MPI::Request::Waitany( nslaves, request );
+         i = indices[k];
+         totptc += buf_recv[i];
+         nmsg++;
+         nresult++;
+         TraceScope trace( "Assign", i+1 );
          if( last < nvol )
          {
             /* If there still task to do */
-            last++;
-            MPI::COMM_WORLD.Send( &last, 1, MPI::INT, i+1, 0 );
+            task[0] = last;
+            task[1] = NextChunk( scheduler, nvol - last, nslaves, batch_left, batch_chunk );
+            last += task[1];
+            MPI::COMM_WORLD.Send( task, 2, MPI::INT, i+1, 0 );
             request[i] = MPI::COMM_WORLD.Irecv( &(buf_recv[i]), 1, MPI::INT, i+1, i+1 );
          }
          else
          {
             /* If all the tasks are completed */
-            MPI::COMM_WORLD.Send( &finish_flag, 1, MPI::INT, i+1, 0 );
+            task[0] = finish_flag;
+            MPI::COMM_WORLD.Send( task, 2, MPI::INT, i+1, 0 );
             nfinish++;
          }
+         nmsg++;
       }
-      delete [] request;
-      delete [] buf_recv;
+   }
+   makespan = MPI::Wtime() - inittime;
 
-   } else {
+   std::cout << "Master: "<<totptc<<" ptcs, makespan "<<makespan<<" s, "
+             << nmsg<<" messages ("<<nmsg/makespan<<" msg/s), busy "
+             << 100.0*(1.0-waittime/makespan)<<"%"<<std::endl;
+   std::cout << "Master loop: "<<(double) nresult/nwait<<" results per wait, "
+             << 1.0e6*(makespan-waittime)/nresult<<" us per result"<<std::endl;
 
-      /* Tasks for slaves */
-      totptc = 0;
-      nvol = 0;
-      buf_recv = new int;
-      MPI::COMM_WORLD.Recv( buf_recv, 1, MPI::INT, 0, 0 );
+   delete [] request;
+   delete [] indices;
+   delete [] buf_recv;
+}
+
+/* Loop of a slave of the master (rank 0 of comm). Returns the number of
+   particles generated. */
+long RunSlave ( const MPI::Intracomm& comm )
+{
+   int    myrank = comm.Get_rank( );
+   int    nvol = 0, nptc, task[2], nclaim = 1;
+   long   totptc = 0;
+   double inittime, waittime;
 
-      /* until all the tasks are note completed */
-      while( *buf_recv != finish_flag )
+   inittime = MPI::Wtime();
+   comm.Recv( task, 2, MPI::INT, 0, 0 );
+   waittime = MPI::Wtime() - inittime;
+
+   /* until all the tasks are note completed */
+   while( task[0] != finish_flag )
+   {
+      nptc = 0;
       {
-         /* Doing a task: Generating a list of particles positionss */
-         nptc = (int) ( ( (float) rand() ) / RAND_MAX * 2500 ) + 2500;
-         for( i = 0; i < nptc; i++ )
+         TraceScope trace( "Generate", task[0], "compute" );
+         for( int ivol = task[0]; ivol < task[0] + task[1]; ivol++ )
          {
-            x = ( (float) rand() ) / RAND_MAX;
-            y = ( (float) rand() ) / RAND_MAX;
-            z = ( (float) rand() ) / RAND_MAX;
+            nptc += GenerateVolume( ivol );
          }
-         totptc += nptc;
-         nvol++;
-         MPI::COMM_WORLD.Send( &nptc, 1, MPI::INT, 0, myrank );
-         MPI::COMM_WORLD.Recv( buf_recv, 1, MPI::INT, 0, 0 );
       }
-      delete buf_recv;
+      totptc += nptc;
+      nvol += task[1];
+      inittime = MPI::Wtime();
+      {
+         TraceScope trace( "Request" );
+         comm.Send( &nptc, 1, MPI::INT, 0, myrank );
+         comm.Recv( task, 2, MPI::INT, 0, 0 );
+      }
+      waittime += MPI::Wtime() - inittime;
+      nclaim++;
+   }
 
-      std::cout << "Generated "<<nvol<<" vol with a total of "<<totptc<<" ptcs"<<std::endl;
+   std::cout << "Generated "<<nvol<<" vol with a total of "<<totptc<<" ptcs, "
+             << "assignment latency "<<1.0e6*waittime/nclaim<<" us"<<std::endl;
+   return totptc;
+}
+
+/* Master-free scheduling: the next volume index is a counter in a window
+   of rank 0, incremented atomically by the rank claiming a chunk */
+void RunRma ( int nvol, int chunk, int myrank, int nprocs )
+{
+   int      counter = 0, first, nvolrank = 0, nclaim = 0;
+   long     nptc = 0, totptc;
+   double   inittime, claimstart, claimtime = 0.0, maxclaim = 0.0, makespan;
+   double   stats[2], sumstats[2], maxspan;
+   MPI_Win  win;
+
+   if( chunk <= 0 ) chunk = 1;
+   if( myrank == 0 )
+   {
+      std::cout << "Generating nvol="<<nvol<<" with "<<nprocs<<" procs (rma, chunk="
+                << chunk << ")"<<std::endl;
    }
 
-   MPI::COMM_WORLD.Barrier( );
-   MPI::Finalize();
+   /* Only rank 0 exposes memory: the counter */
+   MPI_Win_create( &counter, ( myrank == 0 ) ? sizeof(int) : 0, sizeof(int),
+                   MPI_INFO_NULL, MPI::COMM_WORLD, &win );
+   MPI::COMM_WORLD.Barrier();
+   inittime = MPI::Wtime();
+   MPI_Win_lock_all( 0, win );
+   while( true )
+   {
+      claimstart = MPI::Wtime();
+      MPI_Fetch_and_op( &chunk, &first, MPI_INT, 0, 0, MPI_SUM, win );
+      MPI_Win_flush( 0, win );
+      claimstart = MPI::Wtime() - claimstart;
+      claimtime += claimstart;
+      if( claimstart > maxclaim ) maxclaim = claimstart;
+      nclaim++;
+      if( first >= nvol ) break;
+
+      for( int ivol = first; ivol < first + chunk && ivol < nvol; ivol++ )
+      {
+         nptc += GenerateVolume( ivol );
+         nvolrank++;
+      }
+   }
+   MPI_Win_unlock_all( win );
+   makespan = MPI::Wtime() - inittime;
+
+   std::cout << "Rank "<<myrank<<" generated "<<nvolrank<<" vol with a total of "<<nptc
+             << " ptcs, assignment latency "<<1.0e6*claimtime/nclaim<<" us (max "
+             << 1.0e6*maxclaim<<" us)"<<std::endl;
+
+   stats[0] = claimtime;
+   stats[1] = nclaim;
+   MPI::COMM_WORLD.Reduce( stats, sumstats, 2, MPI::DOUBLE, MPI::SUM, 0 );
+   MPI::COMM_WORLD.Reduce( &nptc, &totptc, 1, MPI::LONG, MPI::SUM, 0 );
+   MPI::COMM_WORLD.Reduce( &makespan, &maxspan, 1, MPI::DOUBLE, MPI::MAX, 0 );
+   if( myrank == 0 )
+   {
+      std::cout << "Total: "<<totptc<<" ptcs, makespan "<<maxspan<<" s, "
+                << sumstats[1]/maxspan<<" claims/s, mean assignment latency "
+                << 1.0e6*sumstats[0]/sumstats[1]<<" us"<<std::endl;
+   }
+   MPI_Win_free( &win );
+}
+
+/* Hierarchical distribution: root (rank 0), one sub-master per group of
+   slaves, and the slaves */
+void RunTree ( int nvol, int gsize, int myrank )
+{
+   MPI_Comm       node_comm;
+   MPI::Intracomm local;
+   int            leader, nsub;
+   long           nptc = 0, totptc;
+
+   /* Groups of slaves: per node, or gsize consecutive ranks. The root is
+      in no group. */
+   if( gsize > 0 )
+   {
+      local = MPI::COMM_WORLD.Split( ( myrank == 0 ) ? MPI::UNDEFINED
+                                                     : ( myrank - 1 ) / gsize, myrank );
+   }
+   else
+   {
+      MPI_Comm_split_type( MPI::COMM_WORLD, MPI_COMM_TYPE_SHARED, myrank,
+                           MPI_INFO_NULL, &node_comm );
+      MPI::Intracomm node( node_comm );
+      local = node.Split( ( myrank == 0 ) ? MPI::UNDEFINED : 0, myrank );
+      node.Free( );
+   }
+   leader = ( myrank != 0 && local.Get_rank( ) == 0 ) ? 1 : 0;
+   MPI::COMM_WORLD.Allreduce( &leader, &nsub, 1, MPI::INT, MPI::SUM );
+
+   if( myrank == 0 )
+   {
+      RunTreeRoot( nvol, nsub );
+   }
+   else if( leader )
+   {
+      nptc = RunSubMaster( local );
+   }
+   else
+   {
+      /* Counted by the sub-master of the group */
+      RunSlave( local );
+   }
+
+   MPI::COMM_WORLD.Reduce( &nptc, &totptc, 1, MPI::LONG, MPI::SUM, 0 );
+   if( myrank == 0 )
+   {
+      std::cout << "Total: "<<totptc<<" ptcs"<<std::endl;
+   }
+   if( myrank != 0 ) local.Free( );
+}
+
+/* The root only serves batches to the sub-masters */
+void RunTreeRoot ( int nvol, int nsub )
+{
+   int          last = 0, nfinish = 0, request, task[2];
+   int          batch_left = 0, batch_chunk = 0;
+   long         nmsg = 0;
+   double       inittime, makespan;
+   MPI::Status  status;
+
+   std::cout << "Generating nvol="<<nvol<<" with "<<nsub<<" sub-masters (tree)"<<std::endl;
+   inittime = MPI::Wtime();
+   while( nfinish < nsub )
+   {
+      MPI::COMM_WORLD.Recv( &request, 1, MPI::INT, MPI::ANY_SOURCE, tag_request, status );
+      if( last < nvol )
+      {
+         task[0] = last;
+         task[1] = NextChunk( FACTORING, nvol - last, nsub, batch_left, batch_chunk );
+         last += task[1];
+      }
+      else
+      {
+         task[0] = finish_flag;
+         nfinish++;
+      }
+      MPI::COMM_WORLD.Send( task, 2, MPI::INT, status.Get_source( ), tag_batch );
+      nmsg += 2;
+   }
+   makespan = MPI::Wtime() - inittime;
+
+   std::cout << "Root: makespan "<<makespan<<" s, "<<nvol/makespan<<" vol/s, "
+             << nmsg<<" messages ("<<nmsg/makespan<<" msg/s)"<<std::endl;
+}
+
+/* A sub-master serves the slaves of its group (ranks 1.. of local) one
+   volume at a time from a batch pulled from the root. Without slaves it
+   generates the volumes itself. Returns the number of particles. */
+long RunSubMaster ( const MPI::Intracomm& local )
+{
+   int           nslaves = local.Get_size( ) - 1;
+   int           next = 0, end = 0, request = 0, batch[2], task[2] = { 0, 1 };
+   int           i, nfinish = 0, *buf_recv;
+   bool          exhausted = false;
+   long          totptc = 0;
+   MPI::Request *requests;
+
+   /* Next volume of the batch, a new batch being pulled when it is empty */
+   auto pop = [&]( ) -> int
+   {
+      if( next == end && !exhausted )
+      {
+         MPI::COMM_WORLD.Send( &request, 1, MPI::INT, 0, tag_request );
+         MPI::COMM_WORLD.Recv( batch, 2, MPI::INT, 0, tag_batch );
+         if( batch[0] == finish_flag )
+         {
+            exhausted = true;
+         }
+         else
+         {
+            next = batch[0];
+            end = batch[0] + batch[1];
+         }
+      }
+      return ( next < end ) ? next++ : finish_flag;
+   };
+
+   if( nslaves == 0 )
+   {
+      for( int ivol = pop( ); ivol != finish_flag; ivol = pop( ) ) totptc += GenerateVolume( ivol );
+      return totptc;
+   }
+
+   buf_recv = new int[ nslaves ];
+   requests = new MPI::Request[ nslaves ];
+   for( i = 0; i < nslaves; i++ )
+   {
+      task[0] = pop( );
+      local.Send( task, 2, MPI::INT, i+1, 0 );
+      if( task[0] != finish_flag )
+         requests[i] = local.Irecv( &(buf_recv[i]), 1, MPI::INT, i+1, i+1 );
+      else
+         nfinish++;
+   }
+   while( nfinish < nslaves )
+   {
+      i = MPI::Request::Waitany( nslaves, requests );
+      totptc += buf_recv[i];
+      task[0] = pop( );
+      local.Send( task, 2, MPI::INT, i+1, 0 );
+      if( task[0] != finish_flag )
+         requests[i] = local.Irecv( &(buf_recv[i]), 1, MPI::INT, i+1, i+1 );
+      else
+         nfinish++;
+   }
+
+   delete [] requests;
+   delete [] buf_recv;
+   return totptc;
+}
+
+/* Task of the steal mode: the volumes of the first eighth are generated
+   skew times. Returns the number of particles of the volume. */
+long RunSkewedVolume ( int ivol, int nvol, int skew )
+{
+   long nptc = GenerateVolume( ivol );
+   if( ivol < nvol / 8 )
+   {
+      for( int r = 1; r < skew; r++ ) GenerateVolume( ivol );
+   }
+   return nptc;
+}
+
+/* Distributed work stealing. The deque of a rank is the range [lo, hi) of
+   volume indices: the owner pops at lo, a thief takes the upper half. */
+void RunStealing ( int nvol, int skew, int myrank, int nprocs, bool steal )
+{
+   int          lo, hi, loot[2], dummy = 0, next;
+   int          ndone = 0, nreport = 0, nsteal = 0, nattempt = 0;
+   bool         has_token = ( myrank == 0 ), waiting = false, done = false;
+   long         token, nptc = 0, totptc;
+   double       inittime, worktime = 0.0, taskstart, makespan;
+   double       stats[3], maxstats[3], sumwork;
+   MPI::Status  status;
+
+   lo = (int) ( (long) nvol * myrank / nprocs );
+   hi = (int) ( (long) nvol * ( myrank + 1 ) / nprocs );
+   token = 0;
+   srand( myrank + 1 );
+
+   MPI::COMM_WORLD.Barrier();
+   inittime = MPI::Wtime();
+
+   /* Answers the messages received so far */
+   auto serve = [&]( )
+   {
+      while( MPI::COMM_WORLD.Iprobe( MPI::ANY_SOURCE, MPI::ANY_TAG, status ) )
+      {
+         int source = status.Get_source( );
+         switch( status.Get_tag( ) )
+         {
+         case tag_steal:
+            MPI::COMM_WORLD.Recv( &dummy, 1, MPI::INT, source, tag_steal );
+            loot[1] = ( hi - lo ) / 2;
+            loot[0] = hi - loot[1];
+            hi -= loot[1];
+            MPI::COMM_WORLD.Send( loot, 2, MPI::INT, source, tag_loot );
+            break;
+         case tag_loot:
+            MPI::COMM_WORLD.Recv( loot, 2, MPI::INT, source, tag_loot );
+            waiting = false;
+            if( loot[1] > 0 )
+            {
+               lo = loot[0];
+               hi = loot[0] + loot[1];
+               nsteal++;
+            }
+            break;
+         case tag_token:
+            MPI::COMM_WORLD.Recv( &token, 1, MPI::LONG, source, tag_token );
+            has_token = true;
+            break;
+         case tag_done:
+            MPI::COMM_WORLD.Recv( &dummy, 1, MPI::INT, source, tag_done );
+            done = true;
+            break;
+         }
+      }
+   };
+
+   while( !done )
+   {
+      if( lo < hi )
+      {
+         /* Work on the front of the deque */
+         next = lo++;
+         taskstart = MPI::Wtime();
+         nptc += RunSkewedVolume( next, nvol, skew );
+         worktime += MPI::Wtime() - taskstart;
+         ndone++;
+         if( steal ) serve( );
+         continue;
+      }
+
+      if( !steal )
+      {
+         done = true;
+         break;
+      }
+
+      /* Idle: report the completed volumes with the token */
+      if( has_token )
+      {
+         token += ndone - nreport;
+         nreport = ndone;
+         has_token = false;
+         if( myrank == 0 && token == nvol )
+         {
+            for( int p = 1; p < nprocs; p++ )
+               MPI::COMM_WORLD.Send( &dummy, 1, MPI::INT, p, tag_done );
+            done = true;
+            break;
+         }
+         MPI::COMM_WORLD.Send( &token, 1, MPI::LONG, ( myrank + 1 ) % nprocs, tag_token );
+      }
+
+      /* Idle: ask a random victim */
+      if( !waiting && nprocs > 1 )
+      {
+         int victim = rand( ) % ( nprocs - 1 );
+         if( victim >= myrank ) victim++;
+         MPI::COMM_WORLD.Send( &dummy, 1, MPI::INT, victim, tag_steal );
+         waiting = true;
+         nattempt++;
+      }
+      serve( );
+   }
+
+   /* A steal request may still be unanswered: keep serving until every
+      rank has its answer, which a non-blocking barrier tells */
+   if( steal )
+   {
+      MPI_Request barrier;
+      int         flag = 0;
+
+      while( waiting ) serve( );
+      MPI_Ibarrier( MPI::COMM_WORLD, &barrier );
+      while( !flag )
+      {
+         serve( );
+         MPI_Test( &barrier, &flag, MPI_STATUS_IGNORE );
+      }
+   }
+   makespan = MPI::Wtime() - inittime;
+
+   stats[0] = makespan;
+   stats[1] = worktime;
+   stats[2] = ndone;
+   MPI::COMM_WORLD.Reduce( stats, maxstats, 3, MPI::DOUBLE, MPI::MAX, 0 );
+   MPI::COMM_WORLD.Reduce( &worktime, &sumwork, 1, MPI::DOUBLE, MPI::SUM, 0 );
+   MPI::COMM_WORLD.Reduce( &nptc, &totptc, 1, MPI::LONG, MPI::SUM, 0 );
+   if( steal )
+   {
+      std::cout << "Rank "<<myrank<<": "<<ndone<<" vol, "<<nsteal<<" steals out of "
+                << nattempt<<" attempts"<<std::endl;
+   }
+   if( myrank == 0 )
+   {
+      std::cout << ( steal ? "Work stealing: " : "Static blocks: " )<<totptc<<" ptcs, makespan "
+                << maxstats[0]<<" s, imbalance (max/mean work) "
+                << maxstats[1]/(sumwork/nprocs)<<std::endl;
+   }
+}
+
+/* Master of the prefetch mode: outstanding[i] tasks of slave i are not
+   answered yet. The end message is sent when a slave has none left. A
+   task is {first, count, time of the send}. */
+void RunPrefetchMaster ( int nvol, int nslaves, int depth, double latency )
+{
+   int          i, d, nfinish = 0, *buf_recv, *outstanding, last = 0;
+   long         totptc = 0;
+   double       inittime, makespan, task[3], clock;
+   MPI::Request *request;
+
+   std::cout << "Generating nvol="<<nvol<<" with "<<nslaves<<" procs (prefetch, depth="
+             << depth<<", latency="<<latency<<" us)"<<std::endl;
+
+   /* The master answers the clock ping-pongs of each slave in turn */
+   for( i = 0; i < nslaves; i++ )
+   {
+      for( d = 0; d < nclock; d++ )
+      {
+         MPI::COMM_WORLD.Recv( &clock, 1, MPI::DOUBLE, i+1, tag_clock );
+         clock = MPI::Wtime();
+         MPI::COMM_WORLD.Send( &clock, 1, MPI::DOUBLE, i+1, tag_clock );
+      }
+   }
+
+   auto send = [&]( int slave )
+   {
+      task[2] = MPI::Wtime();
+      MPI::COMM_WORLD.Send( task, 3, MPI::DOUBLE, slave, 0 );
+   };
+
+   buf_recv = new int[ nslaves ];
+   outstanding = new int[ nslaves ];
+   request = new MPI::Request[ nslaves ];
+   inittime = MPI::Wtime();
+
+   /* depth tasks ahead for each slave */
+   for( i = 0; i < nslaves; i++ )
+   {
+      outstanding[i] = 0;
+      for( d = 0; d < depth && last < nvol; d++ )
+      {
+         task[0] = last++;
+         task[1] = 1;
+         send( i+1 );
+         outstanding[i]++;
+      }
+      if( outstanding[i] > 0 )
+      {
+         request[i] = MPI::COMM_WORLD.Irecv( &(buf_recv[i]), 1, MPI::INT, i+1, i+1 );
+      }
+      else
+      {
+         task[0] = finish_flag;
+         send( i+1 );
+         nfinish++;
+      }
+   }
+   while( nfinish < nslaves )
+   {
+      i = MPI::Request::Waitany( nslaves, request );
+      totptc += buf_recv[i];
+      outstanding[i]--;
+      if( last < nvol )
+      {
+         task[0] = last++;
+         task[1] = 1;
+         send( i+1 );
+         outstanding[i]++;
+      }
+      if( outstanding[i] > 0 )
+      {
+         request[i] = MPI::COMM_WORLD.Irecv( &(buf_recv[i]), 1, MPI::INT, i+1, i+1 );
+      }
+      else
+      {
+         task[0] = finish_flag;
+         send( i+1 );
+         nfinish++;
+      }
+   }
+   makespan = MPI::Wtime() - inittime;
+   std::cout << "Master: "<<totptc<<" ptcs, makespan "<<makespan<<" s"<<std::endl;
+
+   delete [] request;
+   delete [] outstanding;
+   delete [] buf_recv;
+}
+
+/* Slave of the prefetch mode: depth receives are posted in a ring of
+   slots; the slot of the current task is re-posted before computing it.
+   A task is usable latency microseconds after it was sent, on the clock
+   of the master shifted by offset (the round trip of shortest time). */
+void RunPrefetchSlave ( int myrank, int depth, double latency )
+{
+   double       (*task)[3] = new double[ depth ][3];
+   int          k, current[2], nptc, nvol = 0;
+   long         totptc = 0;
+   double       waitstart, idletime = 0.0, offset = 0.0, best = 1.0e30, t0, t1, clock;
+   double       arrival;
+   MPI::Request *request = new MPI::Request[ depth ];
+
+   for( k = 0; k < nclock; k++ )
+   {
+      t0 = MPI::Wtime();
+      MPI::COMM_WORLD.Send( &t0, 1, MPI::DOUBLE, 0, tag_clock );
+      MPI::COMM_WORLD.Recv( &clock, 1, MPI::DOUBLE, 0, tag_clock );
+      t1 = MPI::Wtime();
+      if( t1 - t0 < best )
+      {
+         best = t1 - t0;
+         offset = clock - 0.5 * ( t0 + t1 );
+      }
+   }
+
+   for( k = 0; k < depth; k++ )
+      request[k] = MPI::COMM_WORLD.Irecv( task[k], 3, MPI::DOUBLE, 0, 0 );
+
+   k = 0;
+   while( true )
+   {
+      waitstart = MPI::Wtime();
+      request[k].Wait();
+
+      /* Spin on purpose until the emulated latency has elapsed since
+         the master sent the task (on the clock of this slave) */
+      arrival = task[k][2] - offset + latency * 1.0e-6;
+      while( MPI::Wtime() < arrival )
+      {
+      }
+      idletime += MPI::Wtime() - waitstart;
+      if( task[k][0] == finish_flag ) break;
+
+      current[0] = (int) task[k][0];
+      current[1] = (int) task[k][1];
+      request[k] = MPI::COMM_WORLD.Irecv( task[k], 3, MPI::DOUBLE, 0, 0 );
+
+      nptc = 0;
+      for( int ivol = current[0]; ivol < current[0] + current[1]; ivol++ )
+         nptc += GenerateVolume( ivol );
+      totptc += nptc;
+      nvol += current[1];
+      MPI::COMM_WORLD.Send( &nptc, 1, MPI::INT, 0, myrank );
+      k = ( k + 1 ) % depth;
+   }
+
+   /* The other slots will never be matched */
+   for( int j = 0; j < depth; j++ )
+   {
+      if( j == k ) continue;
+      request[j].Cancel();
+      request[j].Wait();
+   }
+
+   std::cout << "Generated "<<nvol<<" vol with a total of "<<totptc<<" ptcs, idle "
+             << 1.0e3*idletime<<" ms"<<std::endl;
+
+   delete [] request;
+   delete [] task;
+}
+
+/* Master of the store mode: request[nslaves] receives the batches of
+   particles of any slave. The loop ends when every slave has finished
+   and every particle reported has been received. */
+void RunStoreMaster ( int nvol, int nslaves, int batch, int nbins )
+{
+   int                i, nfinish = 0, *buf_recv, last = 0, task[2];
+   long               totptc = 0, stored = 0, nbatch = 0, total;
+   double             inittime, elapsed, sum = 0.0;
+   std::vector<float> batchbuf( 3 * (size_t) batch );
+   std::vector<long>  zero( nbins, 0 ), hist( nbins );
+   MPI::Request       *request;
+   MPI::Status        status;
+
+   std::cout << "Generating nvol="<<nvol<<" with "<<nslaves<<" procs (store, batch="
+             << batch<<" ptcs)"<<std::endl;
+
+   buf_recv = new int[ nslaves ];
+   request = new MPI::Request[ nslaves + 1 ];
+   inittime = MPI::Wtime();
+
+   request[nslaves] = MPI::COMM_WORLD.Irecv( batchbuf.data( ), 3 * batch, MPI::FLOAT,
+                                             MPI::ANY_SOURCE, tag_store );
+   for( i = 0; i < nslaves; i++ )
+   {
+      task[0] = ( last < nvol ) ? last++ : finish_flag;
+      task[1] = 1;
+      MPI::COMM_WORLD.Send( task, 2, MPI::INT, i+1, 0 );
+      if( task[0] == finish_flag )
+         nfinish++;
+      else
+         request[i] = MPI::COMM_WORLD.Irecv( &(buf_recv[i]), 1, MPI::INT, i+1, i+1 );
+   }
+   while( nfinish < nslaves || stored < totptc )
+   {
+      i = MPI::Request::Waitany( nslaves + 1, request, status );
+      if( i == nslaves )
+      {
+         /* A batch of particles: the consumer only sums x */
+         int n = status.Get_count( MPI::FLOAT ) / 3;
+         for( int p = 0; p < n; p++ ) sum += batchbuf[3*p];
+         stored += n;
+         nbatch++;
+         request[nslaves] = MPI::COMM_WORLD.Irecv( batchbuf.data( ), 3 * batch, MPI::FLOAT,
+                                                   MPI::ANY_SOURCE, tag_store );
+         continue;
+      }
+      totptc += buf_recv[i];
+      task[0] = ( last < nvol ) ? last++ : finish_flag;
+      MPI::COMM_WORLD.Send( task, 2, MPI::INT, i+1, 0 );
+      if( task[0] == finish_flag )
+         nfinish++;
+      else
+         request[i] = MPI::COMM_WORLD.Irecv( &(buf_recv[i]), 1, MPI::INT, i+1, i+1 );
+   }
+   request[nslaves].Cancel( );
+   request[nslaves].Wait( );
+
+   /* Global histogram: the master has no particle of its own */
+   MPI::COMM_WORLD.Reduce( zero.data( ), hist.data( ), nbins, MPI::LONG, MPI::SUM, 0 );
+   elapsed = MPI::Wtime() - inittime;
+
+   total = 0;
+   std::cout << "Histogram of |r|/sqrt(3):";
+   for( i = 0; i < nbins; i++ )
+   {
+      std::cout << " " << hist[i];
+      total += hist[i];
+   }
+   std::cout << std::endl;
+   std::cout << "Master: "<<stored<<" ptcs stored in "<<nbatch<<" batches (reported "
+             << totptc<<", histogram "<<total<<"), mean x "<<sum/stored<<", "
+             << stored/elapsed<<" ptcs/s end to end"<<std::endl;
+
+   delete [] request;
+   delete [] buf_recv;
+}
+
+/* Slave of the store mode. The particles are copied from the buffer of
+   GenerateVolume to the current arena, which is sent when full. */
+void RunStoreSlave ( int myrank, int batch, int nbins )
+{
+   std::vector<float> arena[2];
+   std::vector<long>  hist( nbins, 0 ), dummy;
+   MPI::Request       send[2];
+   int                current = 0, used = 0, nptc, nvol = 0, task[2];
+   long               totptc = 0;
+   const float        scale = nbins / sqrtf( 3.0f );
+
+   arena[0].resize( 3 * (size_t) batch );
+   arena[1].resize( 3 * (size_t) batch );
+
+   /* Sends the current arena and waits for the other one to be free */
+   auto flush = [&]( )
+   {
+      if( used == 0 ) return;
+      send[current] = MPI::COMM_WORLD.Isend( arena[current].data( ), 3 * used, MPI::FLOAT,
+                                             0, tag_store );
+      current = 1 - current;
+      send[current].Wait( );
+      used = 0;
+   };
+
+   MPI::COMM_WORLD.Recv( task, 2, MPI::INT, 0, 0 );
+   while( task[0] != finish_flag )
+   {
+      nptc = GenerateVolume( task[0] );
+      for( int p = 0; p < nptc; p++ )
+      {
+         float x = volume.x[p], y = volume.y[p], z = volume.z[p];
+         int   bin = (int) ( sqrtf( x*x + y*y + z*z ) * scale );
+
+         if( used == batch ) flush( );
+         arena[current][3*used] = x;
+         arena[current][3*used+1] = y;
+         arena[current][3*used+2] = z;
+         used++;
+         hist[ bin < nbins ? bin : nbins - 1 ]++;
+      }
+      totptc += nptc;
+      nvol++;
+      MPI::COMM_WORLD.Send( &nptc, 1, MPI::INT, 0, myrank );
+      MPI::COMM_WORLD.Recv( task, 2, MPI::INT, 0, 0 );
+   }
+   flush( );
+   send[0].Wait( );
+   send[1].Wait( );
+
+   std::cout << "Generated "<<nvol<<" vol with a total of "<<totptc<<" ptcs"<<std::endl;
+   MPI::COMM_WORLD.Reduce( hist.data( ), dummy.data( ), nbins, MPI::LONG, MPI::SUM, 0 );
+}
+
+/* Master of the threads mode. Each message of a slave is {nptc, more}:
+   the particles generated since its previous message, and whether it
+   wants a new chunk (1) or has finished (0). */
+void RunThreadsMaster ( int nvol, int nslaves, int chunk )
+{
+   int          i, nfinish = 0, (*buf_recv)[2], last = 0, task[2];
+   long         nmsg = 0, totptc = 0;
+   double       inittime, makespan;
+   MPI::Request *request;
+
+   std::cout << "Generating nvol="<<nvol<<" with "<<nslaves<<" procs (threads, chunk="
+             << chunk<<")"<<std::endl;
+
+   buf_recv = new int[ nslaves ][2];
+   request = new MPI::Request[ nslaves ];
+   inittime = MPI::Wtime();
+
+   for( i = 0; i < nslaves; i++ )
+      request[i] = MPI::COMM_WORLD.Irecv( buf_recv[i], 2, MPI::INT, i+1, i+1 );
+   while( nfinish < nslaves )
+   {
+      i = MPI::Request::Waitany( nslaves, request );
+      totptc += buf_recv[i][0];
+      nmsg++;
+      if( buf_recv[i][1] == 0 )
+      {
+         nfinish++;
+         continue;
+      }
+      if( last < nvol )
+      {
+         task[0] = last;
+         task[1] = ( chunk < nvol - last ) ? chunk : nvol - last;
+         last += task[1];
+      }
+      else
+      {
+         task[0] = finish_flag;
+      }
+      MPI::COMM_WORLD.Send( task, 2, MPI::INT, i+1, 0 );
+      nmsg++;
+      request[i] = MPI::COMM_WORLD.Irecv( buf_recv[i], 2, MPI::INT, i+1, i+1 );
+   }
+   makespan = MPI::Wtime() - inittime;
+
+   std::cout << "Master: "<<totptc<<" ptcs, makespan "<<makespan<<" s, "
+             << nmsg<<" messages ("<<nmsg/makespan<<" msg/s), "
+             << totptc/makespan<<" ptcs/s"<<std::endl;
+
+   delete [] request;
+   delete [] buf_recv;
+}
+
+/* Slave of the threads mode: the main thread talks to the master and
+   fills the queue, the pool empties it */
+void RunThreadsSlave ( int myrank, int nthreads )
+{
+   std::mutex               lock;
+   std::condition_variable  work, low;
+   std::deque<int>          queue;
+   bool                     done = false;
+   std::atomic<long>        pending( 0 );
+   std::atomic<int>         nvol( 0 );
+   std::vector<std::thread> pool;
+   long                     totptc = 0;
+   int                      message[2], task[2];
+
+   for( int t = 0; t < nthreads; t++ )
+   {
+      pool.push_back( std::thread( [&]( )
+      {
+         while( true )
+         {
+            std::unique_lock<std::mutex> guard( lock );
+            work.wait( guard, [&]( ) { return !queue.empty( ) || done; } );
+            if( queue.empty( ) ) break;
+            int ivol = queue.front( );
+            queue.pop_front( );
+            if( (int) queue.size( ) < nthreads ) low.notify_one( );
+            guard.unlock( );
+
+            pending += GenerateVolume( ivol );
+            nvol++;
+         }
+      } ) );
+   }
+
+   while( true )
+   {
+      {
+         std::unique_lock<std::mutex> guard( lock );
+         low.wait( guard, [&]( ) { return (int) queue.size( ) < nthreads; } );
+      }
+      message[0] = (int) pending.exchange( 0 );
+      message[1] = 1;
+      totptc += message[0];
+      MPI::COMM_WORLD.Send( message, 2, MPI::INT, 0, myrank );
+      MPI::COMM_WORLD.Recv( task, 2, MPI::INT, 0, 0 );
+
+      std::lock_guard<std::mutex> guard( lock );
+      if( task[0] == finish_flag )
+      {
+         done = true;
+         work.notify_all( );
+         break;
+      }
+      for( int ivol = task[0]; ivol < task[0] + task[1]; ivol++ ) queue.push_back( ivol );
+      work.notify_all( );
+   }
+   for( int t = 0; t < nthreads; t++ ) pool[t].join( );
+
+   /* The particles of the last volumes */
+   message[0] = (int) pending.exchange( 0 );
+   message[1] = 0;
+   totptc += message[0];
+   MPI::COMM_WORLD.Send( message, 2, MPI::INT, 0, myrank );
+
+   std::cout << "Generated "<<nvol<<" vol with a total of "<<totptc<<" ptcs on "
+             << nthreads<<" threads"<<std::endl;
 }
@@ -0,0 +1,290 @@
+/*######################################################################
+
+ Example 18 : Cartesian topology and halo exchange
+
+ Description:
+   This example extends the group machinery of example 13 to a
+   Cartesian communicator, the usual layout of stencil codes.
+   MPI::Compute_dims chooses a balanced 1D, 2D or 3D grid of tasks,
+   COMM_WORLD.Create_cart builds the periodic Cartesian communicator
+   and Shift gives, for each dimension, the neighbours below and
+   above the task.
+
+   Each task owns a block of a 3D field surrounded by one layer of
+   ghost cells in the decomposed dimensions. The faces sent to and
+   received from the neighbours are described by derived datatypes
+   (Create_subarray), so no copy to a buffer is needed.
+
+   At each iteration of a 7-point Jacobi stencil the ghost layers
+   are exchanged with Isend/Irecv. While the messages are in flight
+   the interior points, which do not need the ghost cells, are
+   updated; the boundary points are updated after the Waitall. The
+   same loop without overlap is timed for comparison.
+
+   With "weak" scaling, n is the number of points per dimension of
+   each task; with "strong" scaling, n is the global number of
+   points per dimension, split over the tasks.
+
+   Usage: example18 [ndims] [n] [weak|strong] [niter]
+
+ Last update: October 2026
+
+######################################################################*/
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Local block: nl interior points per dimension, g ghost layers (1 in
+   the decomposed dimensions, 0 in the others) and sz = nl+2g. */
+struct Block
+{
+   int nl[3], g[3], sz[3];
+};
+
+/* Declaration of the functions used by the halo exchange engine */
+void   BuildFaceTypes ( const Block& b, int ndims, MPI::Datatype send[][2],
+                        MPI::Datatype recv[][2] );
+void   Update ( const Block& b, const double* u, double* unew,
+                const int lo[3], const int hi[3] );
+void   UpdateBoundary ( const Block& b, int ndims, const double* u, double* unew );
+double RunStencil ( MPI::Cartcomm& cart, const Block& b, int ndims, int niter,
+                    bool overlap, double* u, double* unew, double* checksum );
+
+int main ( int argc, char** argv )
+{
+   int     ndims, n, niter, nprocs, rank, minnl, allminnl;
+   int     dims[3] = { 0, 0, 0 }, coords[3] = { 0, 0, 0 };
+   bool    periods[3] = { true, true, true }, weak;
+   Block   b;
+   double  *u, *unew, time_overlap, time_plain, sum_overlap, sum_plain;
+   double  local, glob;
+   size_t  npoints;
+
+   MPI::Init(argc, argv);
+   rank = MPI::COMM_WORLD.Get_rank();
+   nprocs = MPI::COMM_WORLD.Get_size();
+
+   ndims = ( argc > 1 ) ? atoi(argv[1]) : 3;
+   n     = ( argc > 2 ) ? atoi(argv[2]) : 64;
+   weak  = !( argc > 3 && strcmp(argv[3], "strong") == 0 );
+   niter = ( argc > 4 ) ? atoi(argv[4]) : 100;
+   if ( ndims < 1 || ndims > 3 ) ndims = 3;
+   if ( niter <= 0 ) niter = 100;
+
+   // Cartesian communicator. reorder=true lets MPI place the
+   // neighbours close to each other.
+   MPI::Compute_dims(nprocs, ndims, dims);
+   MPI::Cartcomm cart = MPI::COMM_WORLD.Create_cart(ndims, dims, periods, true);
+   rank = cart.Get_rank();
+   cart.Get_coords(rank, ndims, coords);
+
+   // Size of the local block
+   for ( int d = 0; d < 3; d++ ){
+      if ( d < ndims ){
+         b.nl[d] = weak ? n : n / dims[d] + ( coords[d] < n % dims[d] ? 1 : 0 );
+         b.g[d] = 1;
+      } else {
+         b.nl[d] = n;
+         b.g[d] = 0;
+      }
+      b.sz[d] = b.nl[d] + 2 * b.g[d];
+   }
+
+   // The smallest block of all the tasks decides, so that they all
+   // stop together
+   minnl = b.nl[0];
+   for ( int d = 1; d < ndims; d++ ) if ( b.nl[d] < minnl ) minnl = b.nl[d];
+   cart.Allreduce(&minnl, &allminnl, 1, MPI::INT, MPI::MIN);
+   if ( allminnl < 3 ){
+      if ( rank == 0 ) printf("n is too small for %d tasks\n", nprocs);
+      cart.Free();
+      MPI::Finalize();
+      return 1;
+   }
+
+   npoints = (size_t) b.sz[0] * b.sz[1] * b.sz[2];
+   u    = new double[npoints];
+   unew = new double[npoints];
+
+   time_plain   = RunStencil(cart, b, ndims, niter, false, u, unew, &sum_plain);
+   time_overlap = RunStencil(cart, b, ndims, niter, true, u, unew, &sum_overlap);
+
+   // Global number of points: n^3 for strong scaling, nprocs n^3 for
+   // weak scaling
+   local = (double) b.nl[0] * b.nl[1] * b.nl[2];
+   cart.Reduce(&local, &glob, 1, MPI::DOUBLE, MPI::SUM, 0);
+
+   if ( rank == 0 ){
+      printf("\n\n\n");
+      printf("##########################################################\n\n");
+      printf(" Example 18 \n\n");
+      printf(" Cartesian halo exchange : %dD decomposition, %s scaling\n\n",
+             ndims, weak ? "weak" : "strong");
+      printf(" Tasks grid: %d x %d x %d\n", dims[0],
+             ndims > 1 ? dims[1] : 1, ndims > 2 ? dims[2] : 1);
+      printf(" Local block (task 0): %d x %d x %d\n", b.nl[0], b.nl[1], b.nl[2]);
+      printf(" Number of iterations: %d\n\n", niter);
+      printf(" Without overlap : %f ms per iteration, %f Mpoints/s, sum=%e\n",
+             1.0e3 * time_plain / niter, glob * niter / time_plain / 1.0e6,
+             sum_plain);
+      printf(" With overlap    : %f ms per iteration, %f Mpoints/s, sum=%e\n\n",
+             1.0e3 * time_overlap / niter, glob * niter / time_overlap / 1.0e6,
+             sum_overlap);
+      printf("##########################################################\n\n");
+   }
+
+   delete [] unew;
+   delete [] u;
+   cart.Free();
+   MPI::Finalize();
+}
+
+// Faces of the block. send[d][0] is the first interior layer along d
+// (sent to the neighbour below), send[d][1] the last one; recv[d][0]
+// and recv[d][1] are the ghost layers below and above.
+void BuildFaceTypes ( const Block& b, int ndims, MPI::Datatype send[][2],
+                      MPI::Datatype recv[][2] )
+{
+   int subsizes[3], starts[3];
+
+   for ( int d = 0; d < ndims; d++ ){
+      for ( int side = 0; side < 2; side++ ){
+         for ( int e = 0; e < 3; e++ ){
+            subsizes[e] = b.nl[e];
+            starts[e] = b.g[e];
+         }
+         subsizes[d] = 1;
+
+         starts[d] = ( side == 0 ) ? b.g[d] : b.nl[d];
+         send[d][side] = MPI::DOUBLE.Create_subarray(3, b.sz, subsizes, starts,
+                                                     MPI::ORDER_C);
+         send[d][side].Commit();
+
+         starts[d] = ( side == 0 ) ? 0 : b.nl[d] + b.g[d];
+         recv[d][side] = MPI::DOUBLE.Create_subarray(3, b.sz, subsizes, starts,
+                                                     MPI::ORDER_C);
+         recv[d][side].Commit();
+      }
+   }
+}
+
+// Jacobi update of the points lo <= (i,j,k) < hi. The neighbours of
+// the dimensions that are not decomposed are taken periodically.
+void Update ( const Block& b, const double* u, double* unew,
+              const int lo[3], const int hi[3] )
+{
+   const size_t s0 = (size_t) b.sz[1] * b.sz[2], s1 = b.sz[2];
+
+   for ( int i = lo[0]; i < hi[0]; i++ ){
+      for ( int j = lo[1]; j < hi[1]; j++ ){
+         size_t row = i * s0 + j * s1;
+         size_t im = ( b.g[0] || i > 0 ) ? s0 : -(size_t)( ( b.nl[0] - 1 ) * s0 );
+         size_t ip = ( b.g[0] || i < b.nl[0] - 1 ) ? s0 : -(size_t)( ( b.nl[0] - 1 ) * s0 );
+         size_t jm = ( b.g[1] || j > 0 ) ? s1 : -(size_t)( ( b.nl[1] - 1 ) * s1 );
+         size_t jp = ( b.g[1] || j < b.nl[1] - 1 ) ? s1 : -(size_t)( ( b.nl[1] - 1 ) * s1 );
+         for ( int k = lo[2]; k < hi[2]; k++ ){
+            size_t p = row + k;
+            size_t km = ( b.g[2] || k > 0 ) ? p - 1 : p + b.nl[2] - 1;
+            size_t kp = ( b.g[2] || k < b.nl[2] - 1 ) ? p + 1 : p - b.nl[2] + 1;
+            unew[p] = ( u[p - im] + u[p + ip] + u[p - jm] + u[p + jp]
+                        + u[km] + u[kp] ) / 6.0;
+         }
+      }
+   }
+}
+
+// Update of the points next to a ghost layer, as one slab per side
+// of each decomposed dimension. The slabs of dimension d exclude the
+// points already done by the slabs of the dimensions before d.
+void UpdateBoundary ( const Block& b, int ndims, const double* u, double* unew )
+{
+   int lo[3], hi[3];
+
+   for ( int d = 0; d < ndims; d++ ){
+      for ( int side = 0; side < 2; side++ ){
+         for ( int e = 0; e < 3; e++ ){
+            lo[e] = b.g[e];
+            hi[e] = b.g[e] + b.nl[e];
+            if ( e < d ){
+               lo[e]++;
+               hi[e]--;
+            }
+         }
+         lo[d] = ( side == 0 ) ? b.g[d] : b.g[d] + b.nl[d] - 1;
+         hi[d] = lo[d] + 1;
+         Update(b, u, unew, lo, hi);
+      }
+   }
+}
+
+// Runs niter Jacobi iterations and returns the maximum time over the
+// tasks. The global sum of the field is returned in checksum.
+double RunStencil ( MPI::Cartcomm& cart, const Block& b, int ndims, int niter,
+                    bool overlap, double* u, double* unew, double* checksum )
+{
+   MPI::Datatype send[3][2], recv[3][2];
+   MPI::Request  request[12];
+   int           below[3], above[3], lo[3], hi[3], coords[3] = { 0, 0, 0 };
+   int           nreq, rank = cart.Get_rank();
+   size_t        npoints = (size_t) b.sz[0] * b.sz[1] * b.sz[2];
+   double        inittime, time, maxtime, sum;
+
+   BuildFaceTypes(b, ndims, send, recv);
+   for ( int d = 0; d < ndims; d++ ) cart.Shift(d, 1, below[d], above[d]);
+
+   // Initial field: a different constant on each task
+   cart.Get_coords(rank, ndims, coords);
+   for ( size_t p = 0; p < npoints; p++ ){
+      u[p] = coords[0] + 10.0 * coords[1] + 100.0 * coords[2];
+      unew[p] = u[p];
+   }
+
+   // Interior points: no neighbour in the ghost layers
+   for ( int e = 0; e < 3; e++ ){
+      lo[e] = b.g[e] + b.g[e];
+      hi[e] = b.nl[e];
+   }
+
+   cart.Barrier();
+   inittime = MPI::Wtime();
+   for ( int iter = 0; iter < niter; iter++ ){
+      nreq = 0;
+      for ( int d = 0; d < ndims; d++ ){
+         request[nreq++] = cart.Irecv(u, 1, recv[d][0], below[d], 2 * d);
+         request[nreq++] = cart.Irecv(u, 1, recv[d][1], above[d], 2 * d + 1);
+         request[nreq++] = cart.Isend(u, 1, send[d][0], below[d], 2 * d + 1);
+         request[nreq++] = cart.Isend(u, 1, send[d][1], above[d], 2 * d);
+      }
+      if ( overlap ){
+         Update(b, u, unew, lo, hi);
+         MPI::Request::Waitall(nreq, request);
+      } else {
+         MPI::Request::Waitall(nreq, request);
+         Update(b, u, unew, lo, hi);
+      }
+      UpdateBoundary(b, ndims, u, unew);
+
+      double *tmp = u;
+      u = unew;
+      unew = tmp;
+   }
+   time = MPI::Wtime() - inittime;
+   cart.Allreduce(&time, &maxtime, 1, MPI::DOUBLE, MPI::MAX);
+
+   // After the last swap the result is in u
+   sum = 0.0;
+   for ( int i = b.g[0]; i < b.g[0] + b.nl[0]; i++ )
+      for ( int j = b.g[1]; j < b.g[1] + b.nl[1]; j++ )
+         for ( int k = b.g[2]; k < b.g[2] + b.nl[2]; k++ )
+            sum += u[( (size_t) i * b.sz[1] + j ) * b.sz[2] + k];
+   cart.Allreduce(&sum, checksum, 1, MPI::DOUBLE, MPI::SUM);
+
+   for ( int d = 0; d < ndims; d++ ){
+      for ( int side = 0; side < 2; side++ ){
+         send[d][side].Free();
+         recv[d][side].Free();
+      }
+   }
+   return maxtime;
+}
@@ -0,0 +1,300 @@
+/*######################################################################
+
+ Example 19 : Batching many small records with a pack arena
+
+ Description:
+   Example 14 packs three variables and broadcasts them in one
+   message. When millions of such small records are produced, one
+   message per record is dominated by the latency of the network.
+
+   This example accumulates the records in a reusable pack arena:
+   the fields of each record are packed one after the other in a
+   large buffer and the starting position of every record is kept
+   in an index. The arena is flushed when it holds more than
+   maxbytes bytes or when its oldest record waits for more than
+   maxdelay seconds. A flush packs the index after the payload, then
+   broadcasts a small header (total packed size, number of records
+   and payload size) followed by exactly that many packed bytes, so
+   the receivers can unpack any record directly from its position.
+   The arena buffers are never freed between flushes.
+
+   The records are heterogeneous: a "triple" {float a, b; int n} as
+   in example 14, or a "particle" {int id; double x, y, z}. The first
+   field of each record is its kind.
+
+   The message rate of the batched broadcast is compared with one
+   Bcast per record.
+
+   Usage: example19 [nrecords] [maxbytes] [maxdelay]
+
+ Last update: October 2026
+
+######################################################################*/
+
+#include "mpi2c++/mpi++.h"
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+
+enum RecordKind { TRIPLE, PARTICLE };
+
+/* Pack arena of a broadcast stream of records from root to all the
+   other tasks of comm. */
+class PackArena
+{
+  public:
+    PackArena ( const MPI::Intracomm& comm, int root, int maxbytes, double maxdelay );
+
+    /* Sender side: pack the fields of a record, then close it. The
+       arena is flushed by EndRecord when a threshold is reached. */
+    void Pack ( const void* inbuf, int count, const MPI::Datatype& type );
+    void EndRecord ( );
+    void Flush ( );
+
+    /* Sender side: flush and tell the receivers the stream is over */
+    void Close ( );
+
+    /* Receiver side: receive the next batch, false at the end of the
+       stream. Record i starts at Position(i). */
+    bool Receive ( );
+    int  Records ( ) const { return (int) index_.size() - 1; }
+    int  Position ( int i ) const { return index_[i]; }
+    void Unpack ( void* outbuf, int count, const MPI::Datatype& type, int& position );
+
+    /* Number of batches sent or received */
+    int  Batches ( ) const { return nbatch_; }
+
+  private:
+    void Reserve ( int bytes );
+
+    MPI::Intracomm    comm_;
+    int               root_, maxbytes_, used_, nbatch_;
+    double            maxdelay_, first_;
+    std::vector<char> buffer_;
+    std::vector<int>  index_;
+};
+
+/* Declaration of the functions of the benchmark */
+void   MakeRecord ( int i, int& kind, float& a, float& b, int& n, double xyz[3] );
+double SendOneByOne ( int nrec, int myrank, double& checksum );
+double SendBatched ( int nrec, int maxbytes, double maxdelay, int myrank,
+                     double& checksum, int& nbatch );
+
+int main ( int argc, char** argv )
+{
+   int     myrank, nrec, maxbytes, nbatch;
+   double  maxdelay, onetime, batchtime, onesum, batchsum;
+
+   MPI::Init(argc, argv);
+   myrank = MPI::COMM_WORLD.Get_rank();
+
+   nrec     = ( argc > 1 ) ? atoi(argv[1]) : 100000;
+   maxbytes = ( argc > 2 ) ? atoi(argv[2]) : 1 << 20;
+   maxdelay = ( argc > 3 ) ? atof(argv[3]) : 1.0e-2;
+   if ( nrec <= 0 ) nrec = 100000;
+   if ( maxbytes <= 0 ) maxbytes = 1 << 20;
+
+   onetime   = SendOneByOne(nrec, myrank, onesum);
+   batchtime = SendBatched(nrec, maxbytes, maxdelay, myrank, batchsum, nbatch);
+
+   // The checksums are computed on the last task from what it received
+   if ( myrank == MPI::COMM_WORLD.Get_size() - 1 ){
+      std::cout << "Records: " << nrec << ", checksums " << onesum
+                << " (one by one) " << batchsum << " (batched)" << std::endl;
+   }
+   if ( myrank == 0 ){
+      std::cout << "One Bcast per record: " << nrec / onetime << " records/s" << std::endl;
+      std::cout << "Batched (" << nbatch << " batches): " << nrec / batchtime
+                << " records/s, speedup " << onetime / batchtime << std::endl;
+   }
+
+   MPI::Finalize();
+}
+
+PackArena::PackArena ( const MPI::Intracomm& comm, int root, int maxbytes,
+                       double maxdelay )
+   : comm_(comm), root_(root), maxbytes_(maxbytes), used_(0), nbatch_(0),
+     maxdelay_(maxdelay), first_(0.)
+{
+   buffer_.resize(maxbytes);
+   index_.push_back(0);
+}
+
+void PackArena::Reserve ( int bytes )
+{
+   if ( used_ + bytes > (int) buffer_.size() ) buffer_.resize(2 * ( used_ + bytes ));
+}
+
+void PackArena::Pack ( const void* inbuf, int count, const MPI::Datatype& type )
+{
+   Reserve(type.Pack_size(count, comm_));
+   if ( index_.size() == 1 && used_ == 0 ) first_ = MPI::Wtime();
+   type.Pack(inbuf, count, &buffer_[0], (int) buffer_.size(), used_, comm_);
+}
+
+void PackArena::EndRecord ( )
+{
+   index_.push_back(used_);
+   if ( used_ >= maxbytes_ || MPI::Wtime() - first_ >= maxdelay_ ) Flush();
+}
+
+// Header {packed bytes, number of records, payload bytes}, then the
+// payload and the index, packed before the header is sent so that the
+// root and the receivers broadcast the same number of bytes
+void PackArena::Flush ( )
+{
+   int header[3] = { 0, Records(), used_ };
+
+   if ( header[1] == 0 ) return;
+   Reserve(MPI::INT.Pack_size((int) index_.size(), comm_));
+   MPI::INT.Pack(&index_[0], (int) index_.size(), &buffer_[0], (int) buffer_.size(),
+                 used_, comm_);
+   header[0] = used_;
+   comm_.Bcast(header, 3, MPI::INT, root_);
+   comm_.Bcast(&buffer_[0], used_, MPI::PACKED, root_);
+   nbatch_++;
+
+   used_ = 0;
+   index_.resize(1);
+}
+
+void PackArena::Close ( )
+{
+   int header[3] = { 0, -1, 0 };
+
+   Flush();
+   comm_.Bcast(header, 3, MPI::INT, root_);
+}
+
+bool PackArena::Receive ( )
+{
+   int header[3], position;
+
+   comm_.Bcast(header, 3, MPI::INT, root_);
+   if ( header[1] < 0 ) return false;
+
+   Reserve(header[0]);
+   comm_.Bcast(&buffer_[0], header[0], MPI::PACKED, root_);
+   nbatch_++;
+
+   index_.resize(header[1] + 1);
+   position = header[2];
+   MPI::INT.Unpack(&buffer_[0], header[0], &index_[0], header[1] + 1, position, comm_);
+   return true;
+}
+
+void PackArena::Unpack ( void* outbuf, int count, const MPI::Datatype& type, int& position )
+{
+   type.Unpack(&buffer_[0], (int) buffer_.size(), outbuf, count, position, comm_);
+}
+
+// Content of record i: every tenth record is a particle
+void MakeRecord ( int i, int& kind, float& a, float& b, int& n, double xyz[3] )
+{
+   kind = ( i % 10 == 9 ) ? PARTICLE : TRIPLE;
+   a = (float) i;
+   b = 2.f;
+   n = i % 7;
+   xyz[0] = xyz[1] = xyz[2] = 0.5 * i;
+}
+
+// Reference: one packed record per Bcast. The receivers do not know
+// the kind in advance, so the size of the largest record is sent.
+double SendOneByOne ( int nrec, int myrank, double& checksum )
+{
+   int    kind, n, position, bufsize;
+   float  a, b;
+   double xyz[3], inittime, time;
+
+   bufsize = MPI::INT.Pack_size(2, MPI::COMM_WORLD)
+           + MPI::DOUBLE.Pack_size(3, MPI::COMM_WORLD);
+   char *buffer = new char[bufsize];
+
+   checksum = 0.;
+   MPI::COMM_WORLD.Barrier();
+   inittime = MPI::Wtime();
+   for ( int i = 0; i < nrec; i++ ){
+      position = 0;
+      if ( myrank == 0 ){
+         MakeRecord(i, kind, a, b, n, xyz);
+         MPI::INT.Pack(&kind, 1, buffer, bufsize, position, MPI::COMM_WORLD);
+         if ( kind == TRIPLE ){
+            MPI::FLOAT.Pack(&a, 1, buffer, bufsize, position, MPI::COMM_WORLD);
+            MPI::FLOAT.Pack(&b, 1, buffer, bufsize, position, MPI::COMM_WORLD);
+            MPI::INT.Pack(&n, 1, buffer, bufsize, position, MPI::COMM_WORLD);
+         } else {
+            MPI::INT.Pack(&i, 1, buffer, bufsize, position, MPI::COMM_WORLD);
+            MPI::DOUBLE.Pack(xyz, 3, buffer, bufsize, position, MPI::COMM_WORLD);
+         }
+      }
+      MPI::COMM_WORLD.Bcast(buffer, bufsize, MPI::PACKED, 0);
+      if ( myrank != 0 ){
+         MPI::INT.Unpack(buffer, bufsize, &kind, 1, position, MPI::COMM_WORLD);
+         if ( kind == TRIPLE ){
+            MPI::FLOAT.Unpack(buffer, bufsize, &a, 1, position, MPI::COMM_WORLD);
+            MPI::FLOAT.Unpack(buffer, bufsize, &b, 1, position, MPI::COMM_WORLD);
+            MPI::INT.Unpack(buffer, bufsize, &n, 1, position, MPI::COMM_WORLD);
+            checksum += a + b + n;
+         } else {
+            MPI::INT.Unpack(buffer, bufsize, &n, 1, position, MPI::COMM_WORLD);
+            MPI::DOUBLE.Unpack(buffer, bufsize, xyz, 3, position, MPI::COMM_WORLD);
+            checksum += n + xyz[0] + xyz[1] + xyz[2];
+         }
+      }
+   }
+   time = MPI::Wtime() - inittime;
+
+   delete [] buffer;
+   return time;
+}
+
+// Same records through the pack arena
+double SendBatched ( int nrec, int maxbytes, double maxdelay, int myrank,
+                     double& checksum, int& nbatch )
+{
+   int       kind, n, position;
+   float     a, b;
+   double    xyz[3], inittime, time;
+   PackArena arena(MPI::COMM_WORLD, 0, maxbytes, maxdelay);
+
+   checksum = 0.;
+   MPI::COMM_WORLD.Barrier();
+   inittime = MPI::Wtime();
+   if ( myrank == 0 ){
+      for ( int i = 0; i < nrec; i++ ){
+         MakeRecord(i, kind, a, b, n, xyz);
+         arena.Pack(&kind, 1, MPI::INT);
+         if ( kind == TRIPLE ){
+            arena.Pack(&a, 1, MPI::FLOAT);
+            arena.Pack(&b, 1, MPI::FLOAT);
+            arena.Pack(&n, 1, MPI::INT);
+         } else {
+            arena.Pack(&i, 1, MPI::INT);
+            arena.Pack(xyz, 3, MPI::DOUBLE);
+         }
+         arena.EndRecord();
+      }
+      arena.Close();
+   } else {
+      while ( arena.Receive() ){
+         for ( int r = 0; r < arena.Records(); r++ ){
+            position = arena.Position(r);
+            arena.Unpack(&kind, 1, MPI::INT, position);
+            if ( kind == TRIPLE ){
+               arena.Unpack(&a, 1, MPI::FLOAT, position);
+               arena.Unpack(&b, 1, MPI::FLOAT, position);
+               arena.Unpack(&n, 1, MPI::INT, position);
+               checksum += a + b + n;
+            } else {
+               arena.Unpack(&n, 1, MPI::INT, position);
+               arena.Unpack(xyz, 3, MPI::DOUBLE, position);
+               checksum += n + xyz[0] + xyz[1] + xyz[2];
+            }
+         }
+      }
+   }
+   time = MPI::Wtime() - inittime;
+   nbatch = arena.Batches();
+
+   return time;
+}
@@ -0,0 +1,206 @@
+/*######################################################################
+
+ mpi_serialize.h : compile-time pack/unpack
+
+ Description:
+   Example 14 packs each variable with MPI::Datatype::Pack, with the
+   sizes (fl_size, int_size) and the order of the calls written by
+   hand. The templates of this header derive them from the list of
+   the fields instead:
+
+     PackedSize<T...>::value   exact size in bytes of the fields,
+                               known at compile time;
+     PackFields / UnpackFields copy the fields one after the other,
+                               each copy being a memcpy of constant
+                               size that the compiler inlines.
+
+   Structures are described once by a specialisation of FieldList
+   giving the tuple of their member pointers, for example:
+
+     template <> struct FieldList<Triple>
+     {
+         static constexpr auto members =
+             std::make_tuple(&Triple::a, &Triple::b, &Triple::n);
+     };
+
+   PackRecords then copies an array of records. Consecutive members
+   of the list that are also adjacent in memory (each one starting
+   where the previous one ends) are merged into runs, computed once
+   per structure since the offsets are only known at run time:
+
+     - when a single run covers the whole structure, the packed
+       records are the bytes of the array, copied with one memcpy;
+     - otherwise each record is copied one run at a time, skipping
+       the padding between the runs.
+
+   The packed bytes are the native representation of the fields and
+   are sent as MPI::BYTE: this is only valid between tasks with the
+   same data representation, which is the case of most clusters.
+   Requires C++17.
+
+ Last update: October 2026
+
+######################################################################*/
+
+#ifndef MPI_SERIALIZE_H
+#define MPI_SERIALIZE_H
+
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+/* Exact packed size of a list of fields */
+template <class... T>
+struct PackedSize
+{
+    static_assert ( ( std::is_trivially_copyable<T>::value && ... ),
+                    "fields must be trivially copyable" );
+    static constexpr int value = ( 0 + ... + (int) sizeof ( T ) );
+};
+
+/* Copy the fields in buffer starting at position, advance position */
+template <class... T>
+inline void PackFields ( char* buffer, int& position, const T&... fields )
+{
+    static_assert ( ( std::is_trivially_copyable<T>::value && ... ),
+                    "fields must be trivially copyable" );
+    ( ( memcpy ( buffer + position, &fields, sizeof ( T ) ),
+        position += (int) sizeof ( T ) ), ... );
+}
+
+/* Reverse of PackFields */
+template <class... T>
+inline void UnpackFields ( const char* buffer, int& position, T&... fields )
+{
+    static_assert ( ( std::is_trivially_copyable<T>::value && ... ),
+                    "fields must be trivially copyable" );
+    ( ( memcpy ( &fields, buffer + position, sizeof ( T ) ),
+        position += (int) sizeof ( T ) ), ... );
+}
+
+/* List of the members of a structure, to be specialised */
+template <class S>
+struct FieldList;
+
+template <class S, class T>
+constexpr int MemberSize ( T S::* )
+{
+    return (int) sizeof ( T );
+}
+
+/* Packed size of one record of S */
+template <class S>
+constexpr int RecordSize ( )
+{
+    return std::apply ( [] ( auto... member ) { return ( 0 + ... + MemberSize ( member ) ); },
+                        FieldList<S>::members );
+}
+
+/* True when the listed members of S fill the whole record */
+template <class S>
+constexpr bool HasNoPadding ( )
+{
+    return std::is_trivially_copyable<S>::value
+        && RecordSize<S> ( ) == (int) sizeof ( S );
+}
+
+/* Offset of a member in a record of S */
+template <class S, class T>
+inline size_t MemberOffset ( T S::* member )
+{
+    static const S probe { };
+    return (size_t) ( (const char*) &( probe.*member ) - (const char*) &probe );
+}
+
+/* Bytes of a record copied by one memcpy */
+struct CopyRun
+{
+    size_t offset, size;
+};
+
+/* Appends a member to the last run when it starts where the run ends */
+inline void AddToRuns ( std::vector<CopyRun>& runs, size_t offset, size_t size )
+{
+    if ( !runs.empty ( ) && runs.back ( ).offset + runs.back ( ).size == offset )
+        runs.back ( ).size += size;
+    else
+        runs.push_back ( CopyRun { offset, size } );
+}
+
+/* Runs of the members of FieldList<S>, in the order of the list */
+template <class S>
+inline const std::vector<CopyRun>& RecordRuns ( )
+{
+    static const std::vector<CopyRun> runs = [] ( )
+    {
+        std::vector<CopyRun> list;
+        std::apply ( [&] ( auto... member )
+                     { ( AddToRuns ( list, MemberOffset ( member ),
+                                     (size_t) MemberSize ( member ) ), ... ); },
+                     FieldList<S>::members );
+        return list;
+    } ( );
+    return runs;
+}
+
+/* True when the packed records of S are the bytes of the array */
+template <class S>
+inline bool IsContiguousRecord ( )
+{
+    static const bool contiguous = HasNoPadding<S> ( ) && RecordRuns<S> ( ).size ( ) == 1
+                                   && RecordRuns<S> ( )[0].offset == 0;
+    return contiguous;
+}
+
+/* Copy count records in buffer starting at position */
+template <class S>
+inline void PackRecords ( char* buffer, int& position, const S* records, int count )
+{
+    if ( IsContiguousRecord<S> ( ) )
+    {
+        memcpy ( buffer + position, records, (size_t) count * sizeof ( S ) );
+        position += count * (int) sizeof ( S );
+    }
+    else
+    {
+        const std::vector<CopyRun>& runs = RecordRuns<S> ( );
+
+        for ( int i = 0; i < count; i++ )
+        {
+            const char* record = (const char*) &records[i];
+            for ( size_t r = 0; r < runs.size ( ); r++ )
+            {
+                memcpy ( buffer + position, record + runs[r].offset, runs[r].size );
+                position += (int) runs[r].size;
+            }
+        }
+    }
+}
+
+/* Reverse of PackRecords */
+template <class S>
+inline void UnpackRecords ( const char* buffer, int& position, S* records, int count )
+{
+    if ( IsContiguousRecord<S> ( ) )
+    {
+        memcpy ( records, buffer + position, (size_t) count * sizeof ( S ) );
+        position += count * (int) sizeof ( S );
+    }
+    else
+    {
+        const std::vector<CopyRun>& runs = RecordRuns<S> ( );
+
+        for ( int i = 0; i < count; i++ )
+        {
+            char* record = (char*) &records[i];
+            for ( size_t r = 0; r < runs.size ( ); r++ )
+            {
+                memcpy ( record + runs[r].offset, buffer + position, runs[r].size );
+                position += (int) runs[r].size;
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,257 @@
+/*######################################################################
+
+ mpi_stats.h : timing statistics over all the tasks
+
+ Description:
+   The examples print the communication time of task 0 only, which
+   says nothing of the other tasks: a slow task is only seen through
+   the time it makes the others wait. ReduceTimings collects the time
+   of every task with a single Reduce:
+
+     - each task fills a TimingRecord (its time as minimum, maximum
+       and sum, its square, the number of tasks, itself as the only
+       entry of the list of the slowest tasks and its hardware
+       counters);
+     - the records are combined by a user-defined operation, which
+       keeps the minimum, the maximum, the sums and merges the lists
+       of the slowest tasks;
+     - the root derives the mean, the standard deviation and the
+       imbalance max/mean, printed by PrintTimings.
+
+   A Gather of the times would move ntasks values to the root; the
+   record has the same size for any number of tasks.
+
+   PerfCounters counts the cycles and instructions of the task
+   between Start and Stop with perf_event_open (Linux). When the
+   counters cannot be opened (kernel.perf_event_paranoid, containers)
+   they are simply not reported.
+
+ Last update: October 2026
+
+######################################################################*/
+
+#ifndef MPI_STATS_H
+#define MPI_STATS_H
+
+#include <mpi.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/* Number of slowest tasks reported */
+const int stats_topk = 3;
+
+/* Statistics of a group of tasks. Only doubles, so that the record is
+   a contiguous block of MPI::DOUBLE. */
+struct TimingRecord
+{
+    double min, max, sum, sumsq, ntasks;
+    double slowtime[stats_topk], slowrank[stats_topk];
+    double cycles, instructions, ncounted;
+};
+
+const int stats_ndoubles = sizeof ( TimingRecord ) / sizeof ( double );
+
+/* Result on the root */
+struct TimingStats
+{
+    int    ntasks;
+    double min, max, mean, stddev, imbalance;
+    int    nslow, slowrank[stats_topk];
+    double slowtime[stats_topk];
+    int    ncounted;
+    double cycles, instructions;
+};
+
+/* Cycles and instructions of this task, if the kernel allows it */
+class PerfCounters
+{
+  public:
+    PerfCounters ( ) : cycles ( 0.0 ), instructions ( 0.0 ), ok ( false )
+    {
+#ifdef __linux__
+        fd_[0] = Open ( PERF_COUNT_HW_CPU_CYCLES );
+        fd_[1] = Open ( PERF_COUNT_HW_INSTRUCTIONS );
+#else
+        fd_[0] = fd_[1] = -1;
+#endif
+        ok = ( fd_[0] >= 0 && fd_[1] >= 0 );
+    }
+
+    ~PerfCounters ( )
+    {
+#ifdef __linux__
+        for ( int i = 0; i < 2; i++ ) if ( fd_[i] >= 0 ) close ( fd_[i] );
+#endif
+    }
+
+    void Start ( )
+    {
+#ifdef __linux__
+        if ( !ok ) return;
+        for ( int i = 0; i < 2; i++ )
+        {
+            ioctl ( fd_[i], PERF_EVENT_IOC_RESET, 0 );
+            ioctl ( fd_[i], PERF_EVENT_IOC_ENABLE, 0 );
+        }
+#endif
+    }
+
+    void Stop ( )
+    {
+#ifdef __linux__
+        long long value[2] = { 0, 0 };
+
+        if ( !ok ) return;
+        for ( int i = 0; i < 2; i++ )
+        {
+            ioctl ( fd_[i], PERF_EVENT_IOC_DISABLE, 0 );
+            if ( read ( fd_[i], &value[i], sizeof ( long long ) ) != sizeof ( long long ) ) ok = false;
+        }
+        cycles = (double) value[0];
+        instructions = (double) value[1];
+#endif
+    }
+
+    double cycles, instructions;
+    bool   ok;
+
+  private:
+#ifdef __linux__
+    static int Open ( int config )
+    {
+        struct perf_event_attr attr;
+
+        memset ( &attr, 0, sizeof ( attr ) );
+        attr.size = sizeof ( attr );
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return (int) syscall ( __NR_perf_event_open, &attr, 0, -1, -1, 0 );
+    }
+#endif
+
+    int fd_[2];
+};
+
+/* User-defined operation: combines len records of in into inout */
+inline void CombineTimings ( const void* in, void* inout, int len, const MPI::Datatype& )
+{
+    const TimingRecord* a = (const TimingRecord*) in;
+    TimingRecord*       b = (TimingRecord*) inout;
+
+    for ( int r = 0; r < len; r++ )
+    {
+        TimingRecord merged = b[r];
+        double       time[2*stats_topk], rank[2*stats_topk];
+        int          n = 0;
+
+        if ( a[r].min < merged.min ) merged.min = a[r].min;
+        if ( a[r].max > merged.max ) merged.max = a[r].max;
+        merged.sum += a[r].sum;
+        merged.sumsq += a[r].sumsq;
+        merged.ntasks += a[r].ntasks;
+        merged.cycles += a[r].cycles;
+        merged.instructions += a[r].instructions;
+        merged.ncounted += a[r].ncounted;
+
+        /* The slowest of both lists, rank -1 for an empty entry */
+        for ( int k = 0; k < stats_topk; k++ )
+        {
+            if ( a[r].slowrank[k] >= 0 ) { time[n] = a[r].slowtime[k]; rank[n++] = a[r].slowrank[k]; }
+            if ( b[r].slowrank[k] >= 0 ) { time[n] = b[r].slowtime[k]; rank[n++] = b[r].slowrank[k]; }
+        }
+        for ( int k = 0; k < stats_topk; k++ )
+        {
+            int best = -1;
+            for ( int i = 0; i < n; i++ )
+                if ( rank[i] >= 0 && ( best < 0 || time[i] > time[best] ) ) best = i;
+            merged.slowtime[k] = ( best < 0 ) ? 0.0 : time[best];
+            merged.slowrank[k] = ( best < 0 ) ? -1.0 : rank[best];
+            if ( best >= 0 ) rank[best] = -1.0;
+        }
+        b[r] = merged;
+    }
+}
+
+/* Statistics of time over the tasks of comm, valid on root only */
+inline TimingStats ReduceTimings ( double time, const PerfCounters* counters = NULL,
+                                   const MPI::Intracomm& comm = MPI::COMM_WORLD, int root = 0 )
+{
+    TimingRecord  mine, all;
+    TimingStats   stats;
+    MPI::Datatype recordtype = MPI::DOUBLE.Create_contiguous ( stats_ndoubles );
+    MPI::Op       combine;
+
+    mine.min = mine.max = mine.sum = time;
+    mine.sumsq = time * time;
+    mine.ntasks = 1.0;
+    for ( int k = 0; k < stats_topk; k++ )
+    {
+        mine.slowtime[k] = 0.0;
+        mine.slowrank[k] = -1.0;
+    }
+    mine.slowtime[0] = time;
+    mine.slowrank[0] = comm.Get_rank ( );
+    mine.ncounted = ( counters != NULL && counters->ok ) ? 1.0 : 0.0;
+    mine.cycles = ( mine.ncounted > 0.0 ) ? counters->cycles : 0.0;
+    mine.instructions = ( mine.ncounted > 0.0 ) ? counters->instructions : 0.0;
+
+    recordtype.Commit ( );
+    combine.Init ( CombineTimings, true );
+    comm.Reduce ( &mine, &all, 1, recordtype, combine, root );
+    combine.Free ( );
+    recordtype.Free ( );
+
+    memset ( &stats, 0, sizeof ( stats ) );
+    if ( comm.Get_rank ( ) != root ) return stats;
+
+    stats.ntasks = (int) all.ntasks;
+    stats.min = all.min;
+    stats.max = all.max;
+    stats.mean = all.sum / all.ntasks;
+    stats.stddev = sqrt ( fmax ( all.sumsq / all.ntasks - stats.mean * stats.mean, 0.0 ) );
+    stats.imbalance = ( stats.mean > 0.0 ) ? stats.max / stats.mean : 1.0;
+    for ( int k = 0; k < stats_topk && all.slowrank[k] >= 0; k++ )
+    {
+        stats.slowrank[k] = (int) all.slowrank[k];
+        stats.slowtime[k] = all.slowtime[k];
+        stats.nslow++;
+    }
+    stats.ncounted = (int) all.ncounted;
+    if ( stats.ncounted > 0 )
+    {
+        stats.cycles = all.cycles / all.ncounted;
+        stats.instructions = all.instructions / all.ncounted;
+    }
+    return stats;
+}
+
+/* Prints the statistics on the root, one line per item */
+inline void PrintTimings ( const char* label, const TimingStats& stats )
+{
+    printf ( " %s : mean %f s, min %f s, max %f s, stddev %f s\n", label, stats.mean,
+             stats.min, stats.max, stats.stddev );
+    printf ( " Imbalance (max/mean) : %f\n", stats.imbalance );
+    printf ( " Slowest tasks :" );
+    for ( int k = 0; k < stats.nslow; k++ )
+        printf ( " %d (%f s)", stats.slowrank[k], stats.slowtime[k] );
+    printf ( "\n" );
+    if ( stats.ncounted > 0 )
+    {
+        printf ( " Counters (mean of %d tasks) : %.0f cycles, %.0f instructions, IPC %f\n",
+                 stats.ncounted, stats.cycles, stats.instructions,
+                 ( stats.cycles > 0.0 ) ? stats.instructions / stats.cycles : 0.0 );
+    }
+    printf ( "\n" );
+}
+
+#endif
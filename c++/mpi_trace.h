@@ -0,0 +1,202 @@
+/*######################################################################
+
+ mpi_trace.h : timeline of the communications
+
+ Description:
+   The examples print one communication time, measured between
+   inittime and totaltime. These functions record every region of
+   the program as an event {name, start, duration} per task and
+   write all the events in the Trace Event format of Chrome, which
+   chrome://tracing or https://ui.perfetto.dev display as one line
+   per task: a late sender appears as a long Recv on the receiver,
+   a load imbalance as long Barrier or Wait events.
+
+     TraceInit ( )        after MPI::Init, collective. The tracing is
+                          enabled when the environment variable
+                          MPI_TRACE holds a file name on task 0.
+     TraceScope s("Recv") records the region from its construction to
+                          the end of its block. The name must be a
+                          string literal; an optional integer (a
+                          volume, a task) is written in the arguments.
+     TraceFinalize ( )    before MPI::Finalize, collective. The events
+                          are gathered on task 0 and written in the
+                          file MPI_TRACE.
+
+   MPI::Wtime is not synchronised between nodes. TraceInit measures
+   the offset of the clock of every task with respect to task 0 by
+   a few ping-pongs, keeping the one of shortest round trip (the
+   offset is the time of task 0 minus the middle of the round trip),
+   and the events are written on the clock of task 0. When tracing
+   is disabled a TraceScope costs one test.
+
+   Example: mpirun -x MPI_TRACE=ring.json -np 4 ./example05 1000
+
+ Last update: October 2026
+
+######################################################################*/
+
+#ifndef MPI_TRACE_H
+#define MPI_TRACE_H
+
+#include <mpi.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+struct TraceEvent
+{
+    const char *name, *category;
+    double      start, duration;
+    long        arg;
+};
+
+/* State of the tracing of this task */
+struct TraceState
+{
+    bool                    enabled = false;
+    double                  offset = 0.0;
+    std::vector<TraceEvent> events;
+};
+
+inline TraceState& Trace ( )
+{
+    static TraceState state;
+    return state;
+}
+
+inline void TraceInit ( const MPI::Intracomm& comm = MPI::COMM_WORLD )
+{
+    const int   npingpong = 10, tag = 31000;
+    TraceState& state = Trace ( );
+    int         rank = comm.Get_rank ( ), nprocs = comm.Get_size ( ), enabled;
+    double      t0, t1, remote, best = 1.0e30;
+
+    enabled = ( rank == 0 && getenv ( "MPI_TRACE" ) != NULL ) ? 1 : 0;
+    comm.Bcast ( &enabled, 1, MPI::INT, 0 );
+    state.enabled = ( enabled == 1 );
+    if ( !state.enabled ) return;
+    state.events.reserve ( 1 << 16 );
+
+    /* Task 0 answers the ping-pongs of each task in turn */
+    for ( int p = 1; p < nprocs; p++ )
+    {
+        for ( int i = 0; i < npingpong; i++ )
+        {
+            if ( rank == 0 )
+            {
+                comm.Recv ( &remote, 1, MPI::DOUBLE, p, tag );
+                remote = MPI::Wtime ( );
+                comm.Send ( &remote, 1, MPI::DOUBLE, p, tag );
+            }
+            else if ( rank == p )
+            {
+                t0 = MPI::Wtime ( );
+                comm.Send ( &t0, 1, MPI::DOUBLE, 0, tag );
+                comm.Recv ( &remote, 1, MPI::DOUBLE, 0, tag );
+                t1 = MPI::Wtime ( );
+                if ( t1 - t0 < best )
+                {
+                    best = t1 - t0;
+                    state.offset = remote - 0.5 * ( t0 + t1 );
+                }
+            }
+        }
+    }
+}
+
+/* Region from the construction to the destruction */
+class TraceScope
+{
+  public:
+    TraceScope ( const char* name, long arg = -1, const char* category = "mpi" )
+        : name_ ( name ), category_ ( category ), arg_ ( arg ),
+          start_ ( Trace ( ).enabled ? MPI::Wtime ( ) : 0.0 ) { }
+
+    ~TraceScope ( )
+    {
+        TraceState& state = Trace ( );
+        if ( state.enabled )
+        {
+            TraceEvent event = { name_, category_, start_, MPI::Wtime ( ) - start_, arg_ };
+            state.events.push_back ( event );
+        }
+    }
+
+  private:
+    const char *name_, *category_;
+    long        arg_;
+    double      start_;
+};
+
+inline void TraceFinalize ( const MPI::Intracomm& comm = MPI::COMM_WORLD )
+{
+    TraceState&       state = Trace ( );
+    int               rank = comm.Get_rank ( ), nprocs = comm.Get_size ( ), length;
+    std::string       json;
+    std::vector<int>  lengths, displs;
+    std::vector<char> all;
+    char              line[512];
+
+    if ( !state.enabled ) return;
+
+    /* Events of this task, times in microseconds on the clock of task 0 */
+    snprintf ( line, sizeof ( line ), "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, "
+               "\"args\": {\"name\": \"task %d\"}}", rank, rank );
+    json = line;
+    for ( size_t i = 0; i < state.events.size ( ); i++ )
+    {
+        const TraceEvent& e = state.events[i];
+        snprintf ( line, sizeof ( line ), ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", "
+                   "\"pid\": %d, \"tid\": 0, \"ts\": %.3f, \"dur\": %.3f, \"args\": {\"arg\": %ld}}",
+                   e.name, e.category, rank, 1.0e6 * ( e.start + state.offset ),
+                   1.0e6 * e.duration, e.arg );
+        json += line;
+    }
+
+    length = (int) json.size ( );
+    if ( rank == 0 )
+    {
+        lengths.resize ( nprocs );
+        displs.resize ( nprocs );
+    }
+    comm.Gather ( &length, 1, MPI::INT, lengths.data ( ), 1, MPI::INT, 0 );
+    if ( rank == 0 )
+    {
+        int total = 0;
+        for ( int p = 0; p < nprocs; p++ )
+        {
+            displs[p] = total;
+            total += lengths[p];
+        }
+        all.resize ( total );
+    }
+    comm.Gatherv ( json.data ( ), length, MPI::CHAR, all.data ( ), lengths.data ( ),
+                   displs.data ( ), MPI::CHAR, 0 );
+
+    if ( rank == 0 )
+    {
+        const char* filename = getenv ( "MPI_TRACE" );
+        FILE*       file = fopen ( filename, "w" );
+
+        if ( file == NULL )
+        {
+            fprintf ( stderr, "Cannot write the trace in %s\n", filename );
+        }
+        else
+        {
+            fprintf ( file, "{\"traceEvents\": [\n" );
+            for ( int p = 0; p < nprocs; p++ )
+            {
+                if ( p > 0 ) fprintf ( file, ",\n" );
+                fwrite ( all.data ( ) + displs[p], 1, lengths[p], file );
+            }
+            fprintf ( file, "\n], \"displayTimeUnit\": \"ms\"}\n" );
+            fclose ( file );
+        }
+    }
+    state.events.clear ( );
+    state.enabled = false;
+}
+
+#endif
@@ -0,0 +1,121 @@
+/*######################################################################
+
+ mpi_type.h : registry of derived datatypes
+
+ Description:
+   BuildMPIParticuleType in example 15 computes the displacements of
+   the members with Get_address and creates and commits a new
+   datatype at each call. mpi_type<T>() does it once per type:
+
+     - the members of T are taken from the FieldList<T> specialisation
+       of mpi_serialize.h (a tuple of member pointers);
+     - each member is mapped to its basic MPI datatype, arrays of a
+       basic type giving one block of their length;
+     - the Create_struct datatype is resized with Create_resized to
+       sizeof(T), so that the trailing padding is part of the extent
+       and arrays of T can be sent with a count;
+     - the committed datatype is cached, later calls only return it.
+
+   FreeMpiTypes() frees every cached datatype; it must be called
+   before MPI::Finalize if the datatypes are to be released, and the
+   next call of mpi_type<T>() then builds a new one.
+
+ Last update: October 2026
+
+######################################################################*/
+
+#ifndef MPI_TYPE_H
+#define MPI_TYPE_H
+
+#include <mpi.h>
+#include <vector>
+#include "mpi_serialize.h"
+
+/* Basic MPI datatype of a C++ type */
+template <class T> struct MpiBasicType;
+template <> struct MpiBasicType<char>           { static MPI::Datatype Get ( ) { return MPI::CHAR; } };
+template <> struct MpiBasicType<short>          { static MPI::Datatype Get ( ) { return MPI::SHORT; } };
+template <> struct MpiBasicType<int>            { static MPI::Datatype Get ( ) { return MPI::INT; } };
+template <> struct MpiBasicType<long>           { static MPI::Datatype Get ( ) { return MPI::LONG; } };
+template <> struct MpiBasicType<unsigned char>  { static MPI::Datatype Get ( ) { return MPI::UNSIGNED_CHAR; } };
+template <> struct MpiBasicType<unsigned short> { static MPI::Datatype Get ( ) { return MPI::UNSIGNED_SHORT; } };
+template <> struct MpiBasicType<unsigned>       { static MPI::Datatype Get ( ) { return MPI::UNSIGNED; } };
+template <> struct MpiBasicType<unsigned long>  { static MPI::Datatype Get ( ) { return MPI::UNSIGNED_LONG; } };
+template <> struct MpiBasicType<float>          { static MPI::Datatype Get ( ) { return MPI::FLOAT; } };
+template <> struct MpiBasicType<double>         { static MPI::Datatype Get ( ) { return MPI::DOUBLE; } };
+
+/* Block of one member: a basic type or an array of a basic type */
+template <class T> struct MpiBlock
+{
+    static MPI::Datatype Type ( ) { return MpiBasicType<T>::Get ( ); }
+    static int           Length ( ) { return 1; }
+};
+
+template <class T, std::size_t N> struct MpiBlock<T[N]>
+{
+    static MPI::Datatype Type ( ) { return MpiBasicType<T>::Get ( ); }
+    static int           Length ( ) { return (int) N; }
+};
+
+/* Every datatype built by mpi_type<T>() */
+inline std::vector<MPI::Datatype*>& MpiTypeRegistry ( )
+{
+    static std::vector<MPI::Datatype*> registry;
+    return registry;
+}
+
+template <class S, class T>
+inline void AddMpiBlock ( S& object, T S::* member, int& i, int* length,
+                          MPI::Aint* displacement, MPI::Datatype* type )
+{
+    length[i] = MpiBlock<T>::Length ( );
+    displacement[i] = MPI::Get_address ( &( object.*member ) ) - MPI::Get_address ( &object );
+    type[i] = MpiBlock<T>::Type ( );
+    i++;
+}
+
+/* Builds and commits the datatype of S from FieldList<S> */
+template <class S>
+MPI::Datatype BuildMpiType ( )
+{
+    const int     nblock = (int) std::tuple_size<decltype ( FieldList<S>::members )>::value;
+    int           length[nblock];
+    MPI::Aint     displacement[nblock];
+    MPI::Datatype type[nblock];
+    S             object = S ( );
+    int           i = 0;
+
+    std::apply ( [&] ( auto... member )
+                 { ( AddMpiBlock ( object, member, i, length, displacement, type ), ... ); },
+                 FieldList<S>::members );
+
+    MPI::Datatype structtype = MPI::Datatype::Create_struct ( nblock, length, displacement, type );
+    MPI::Datatype resized = structtype.Create_resized ( 0, sizeof ( S ) );
+    structtype.Free ( );
+    resized.Commit ( );
+    return resized;
+}
+
+/* Cached datatype of S, built on the first call */
+template <class S>
+const MPI::Datatype& mpi_type ( )
+{
+    static MPI::Datatype type = MPI::DATATYPE_NULL;
+
+    if ( type == MPI::DATATYPE_NULL )
+    {
+        type = BuildMpiType<S> ( );
+        MpiTypeRegistry ( ).push_back ( &type );
+    }
+    return type;
+}
+
+/* Frees every cached datatype */
+inline void FreeMpiTypes ( )
+{
+    std::vector<MPI::Datatype*>& registry = MpiTypeRegistry ( );
+    for ( size_t i = 0; i < registry.size ( ); i++ ) registry[i]->Free ( );
+    registry.clear ( );
+}
+
+#endif
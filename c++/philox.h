@@ -0,0 +1,113 @@
+/*######################################################################
+
+ philox.h : counter-based random numbers
+
+ Description:
+   The examples draw their particles with rand(): one call per
+   coordinate, a hidden state shared by the whole task, and a
+   sequence that depends on the order of the calls. When the volumes
+   are scheduled dynamically (example 16) the particles of a volume
+   then depend on the slave that generates it and on what it
+   generated before.
+
+   Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as
+   1, 2, 3", SC11) has no state: the value number i of a stream is a
+   function of (key, stream, i) only, computed by ten rounds of
+   multiplications and xors of a 128-bit counter. Here:
+
+     - the key is the seed of the run;
+     - the stream is chosen by the caller (a volume index, a rank);
+     - the counter is the index of a block of four 32-bit values.
+
+   Philox::Uniform(first, n, out) fills out with the values first to
+   first+n-1 of the stream as floats or doubles in [0,1). The blocks
+   are independent, so the loop over them has no dependency and can
+   be vectorised by the compiler; any part of a stream can be drawn
+   again or drawn by another task with the same result.
+
+ Last update: October 2026
+
+######################################################################*/
+
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <cstdint>
+
+class Philox
+{
+  public:
+    Philox ( uint64_t seed, uint64_t stream )
+        : key0_ ( (uint32_t) seed ), key1_ ( (uint32_t) ( seed >> 32 ) ),
+          stream0_ ( (uint32_t) stream ), stream1_ ( (uint32_t) ( stream >> 32 ) ) { }
+
+    /* Block number counter of the stream: four 32-bit values */
+    inline void Block ( uint64_t counter, uint32_t out[4] ) const;
+
+    /* Values first to first+n-1 of the stream, uniform in [0,1) */
+    template <class T>
+    void Uniform ( uint64_t first, uint64_t n, T* out ) const;
+
+  private:
+    static float  ToUniform ( uint32_t v, float* ) { return ( v >> 8 ) * ( 1.0f / 16777216.0f ); }
+    static double ToUniform ( uint32_t v, double* ) { return v * ( 1.0 / 4294967296.0 ); }
+
+    uint32_t key0_, key1_, stream0_, stream1_;
+};
+
+inline void Philox::Block ( uint64_t counter, uint32_t out[4] ) const
+{
+    uint32_t c0 = (uint32_t) counter, c1 = (uint32_t) ( counter >> 32 );
+    uint32_t c2 = stream0_, c3 = stream1_;
+    uint32_t k0 = key0_, k1 = key1_;
+
+    for ( int round = 0; round < 10; round++ )
+    {
+        uint64_t p0 = (uint64_t) 0xD2511F53u * c0;
+        uint64_t p1 = (uint64_t) 0xCD9E8D57u * c2;
+        uint32_t n0 = (uint32_t) ( p1 >> 32 ) ^ c1 ^ k0;
+        uint32_t n2 = (uint32_t) ( p0 >> 32 ) ^ c3 ^ k1;
+
+        c1 = (uint32_t) p1;
+        c3 = (uint32_t) p0;
+        c0 = n0;
+        c2 = n2;
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+template <class T>
+void Philox::Uniform ( uint64_t first, uint64_t n, T* out ) const
+{
+    uint32_t block[4];
+    uint64_t last = first + n;
+    uint64_t i = first;
+
+    /* Leading values up to a block boundary */
+    if ( i % 4 != 0 && i < last )
+    {
+        Block ( i / 4, block );
+        for ( ; i % 4 != 0 && i < last; i++ ) out[i - first] = ToUniform ( block[i % 4], out );
+    }
+
+    /* Whole blocks */
+    for ( ; i + 4 <= last; i += 4 )
+    {
+        Block ( i / 4, block );
+        for ( int j = 0; j < 4; j++ ) out[i - first + j] = ToUniform ( block[j], out );
+    }
+
+    /* Trailing values */
+    if ( i < last )
+    {
+        Block ( i / 4, block );
+        for ( ; i < last; i++ ) out[i - first] = ToUniform ( block[i % 4], out );
+    }
+}
+
+#endif
@@ -0,0 +1,280 @@
+/*######################################################################
+
+ pmpi_profile.cpp : MPI profiling library
+
+ Description:
+   The MPI standard gives every function MPI_Xxx a second name
+   PMPI_Xxx. A library defining its own MPI_Xxx, which calls
+   PMPI_Xxx to do the real work, intercepts the calls of a program
+   without any change to its source. The C++ bindings used by the
+   examples call the C functions, so they are intercepted as well.
+
+   This library intercepts the calls used by the examples:
+
+     Send, Recv, Isend, Irecv, Start, Wait, Waitany, Waitsome,
+     Waitall, Test, Bcast, Scatter, Scatterv, Gather, Allgather,
+     Alltoall, Reduce, Iallreduce, Barrier
+
+   and counts, for each of them, the number of calls, the bytes of the
+   local buffer (count times the size of the datatype; the send side
+   for Gather, Allgather and Alltoall, the receive side for Scatter
+   and Scatterv, none for Start and the completion calls) and the time
+   spent in the call. The counters of a
+   task are a static array: no allocation and no I/O happen before
+   MPI_Finalize.
+
+   In MPI_Finalize the counters are reduced on task 0, which prints
+   a summary on stderr: total calls and bytes, and the time per task
+   (minimum, average and maximum over the tasks) of each call.
+
+   Build and use (Open MPI):
+
+     mpicxx -shared -fPIC -O2 pmpi_profile.cpp -o libpmpi_profile.so
+     mpirun -x LD_PRELOAD=$PWD/libpmpi_profile.so -np 4 ./example03 1000
+
+   or link it before the MPI library: mpicxx example03.cpp
+   -L. -lpmpi_profile.
+
+ Last update: October 2026
+
+######################################################################*/
+
+#include <mpi.h>
+#include <stdio.h>
+
+enum ProfiledCall { SEND, RECV, ISEND, IRECV, START, WAIT, WAITANY, WAITSOME, WAITALL,
+                    TEST, BCAST, SCATTER, SCATTERV, GATHER, ALLGATHER, ALLTOALL, REDUCE,
+                    IALLREDUCE, BARRIER, NCALLS };
+
+static const char *call_names[NCALLS] = { "Send", "Recv", "Isend", "Irecv", "Start",
+                                          "Wait", "Waitany", "Waitsome", "Waitall", "Test",
+                                          "Bcast", "Scatter", "Scatterv", "Gather",
+                                          "Allgather", "Alltoall", "Reduce", "Iallreduce",
+                                          "Barrier" };
+
+/* Counters of this task: calls, bytes and seconds of each call */
+static double profile[3][NCALLS];
+
+static inline double Bytes ( int count, MPI_Datatype type )
+{
+   int size = 0;
+   if ( type != MPI_DATATYPE_NULL ) PMPI_Type_size(type, &size);
+   return (double)count * size;
+}
+
+static inline void Record ( ProfiledCall call, double bytes, double start )
+{
+   profile[0][call] += 1.0;
+   profile[1][call] += bytes;
+   profile[2][call] += PMPI_Wtime() - start;
+}
+
+extern "C" {
+
+int MPI_Send ( const void *buf, int count, MPI_Datatype type, int dest, int tag,
+               MPI_Comm comm )
+{
+   double start = PMPI_Wtime();
+   int    ierr = PMPI_Send(buf, count, type, dest, tag, comm);
+   Record(SEND, Bytes(count, type), start);
+   return ierr;
+}
+
+int MPI_Recv ( void *buf, int count, MPI_Datatype type, int source, int tag,
+               MPI_Comm comm, MPI_Status *status )
+{
+   double start = PMPI_Wtime();
+   int    ierr = PMPI_Recv(buf, count, type, source, tag, comm, status);
+   Record(RECV, Bytes(count, type), start);
+   return ierr;
+}
+
+int MPI_Isend ( const void *buf, int count, MPI_Datatype type, int dest, int tag,
+                MPI_Comm comm, MPI_Request *request )
+{
+   double start = PMPI_Wtime();
+   int    ierr = PMPI_Isend(buf, count, type, dest, tag, comm, request);
+   Record(ISEND, Bytes(count, type), start);
+   return ierr;
+}
+
+int MPI_Irecv ( void *buf, int count, MPI_Datatype type, int source, int tag,
+                MPI_Comm comm, MPI_Request *request )
+{
+   double start = PMPI_Wtime();
+   int    ierr = PMPI_Irecv(buf, count, type, source, tag, comm, request);
+   Record(IRECV, Bytes(count, type), start);
+   return ierr;
+}
+
+int MPI_Start ( MPI_Request *request )
+{
+   double start = PMPI_Wtime();
+   int    ierr = PMPI_Start(request);
+   Record(START, 0.0, start);
+   return ierr;
+}
+
+int MPI_Wait ( MPI_Request *request, MPI_Status *status )
+{
+   double start = PMPI_Wtime();
+   int    ierr = PMPI_Wait(request, status);
+   Record(WAIT, 0.0, start);
+   return ierr;
+}
+
+int MPI_Waitany ( int count, MPI_Request requests[], int *index, MPI_Status *status )
+{
+   double start = PMPI_Wtime();
+   int    ierr = PMPI_Waitany(count, requests, index, status);
+   Record(WAITANY, 0.0, start);
+   return ierr;
+}
+
+int MPI_Waitsome ( int incount, MPI_Request requests[], int *outcount, int indices[],
+                   MPI_Status statuses[] )
+{
+   double start = PMPI_Wtime();
+   int    ierr = PMPI_Waitsome(incount, requests, outcount, indices, statuses);
+   Record(WAITSOME, 0.0, start);
+   return ierr;
+}
+
+int MPI_Waitall ( int count, MPI_Request requests[], MPI_Status statuses[] )
+{
+   double start = PMPI_Wtime();
+   int    ierr = PMPI_Waitall(count, requests, statuses);
+   Record(WAITALL, 0.0, start);
+   return ierr;
+}
+
+int MPI_Test ( MPI_Request *request, int *flag, MPI_Status *status )
+{
+   double start = PMPI_Wtime();
+   int    ierr = PMPI_Test(request, flag, status);
+   Record(TEST, 0.0, start);
+   return ierr;
+}
+
+int MPI_Bcast ( void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm )
+{
+   double start = PMPI_Wtime();
+   int    ierr = PMPI_Bcast(buf, count, type, root, comm);
+   Record(BCAST, Bytes(count, type), start);
+   return ierr;
+}
+
+int MPI_Scatter ( const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                  void *recvbuf, int recvcount, MPI_Datatype recvtype, int root,
+                  MPI_Comm comm )
+{
+   double start = PMPI_Wtime();
+   int    ierr = PMPI_Scatter(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype,
+                              root, comm);
+   Record(SCATTER, ( recvbuf == MPI_IN_PLACE ) ? Bytes(sendcount, sendtype)
+                                               : Bytes(recvcount, recvtype), start);
+   return ierr;
+}
+
+int MPI_Scatterv ( const void *sendbuf, const int sendcounts[], const int displs[],
+                   MPI_Datatype sendtype, void *recvbuf, int recvcount,
+                   MPI_Datatype recvtype, int root, MPI_Comm comm )
+{
+   double start = PMPI_Wtime();
+   int    ierr = PMPI_Scatterv(sendbuf, sendcounts, displs, sendtype, recvbuf, recvcount,
+                               recvtype, root, comm);
+   Record(SCATTERV, ( recvbuf == MPI_IN_PLACE ) ? 0.0 : Bytes(recvcount, recvtype), start);
+   return ierr;
+}
+
+int MPI_Gather ( const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                 void *recvbuf, int recvcount, MPI_Datatype recvtype, int root,
+                 MPI_Comm comm )
+{
+   double start = PMPI_Wtime();
+   int    ierr = PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype,
+                             root, comm);
+   Record(GATHER, ( sendbuf == MPI_IN_PLACE ) ? Bytes(recvcount, recvtype)
+                                              : Bytes(sendcount, sendtype), start);
+   return ierr;
+}
+
+int MPI_Allgather ( const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                    void *recvbuf, int recvcount, MPI_Datatype recvtype, MPI_Comm comm )
+{
+   double start = PMPI_Wtime();
+   int    ierr = PMPI_Allgather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype,
+                                comm);
+   Record(ALLGATHER, ( sendbuf == MPI_IN_PLACE ) ? Bytes(recvcount, recvtype)
+                                                 : Bytes(sendcount, sendtype), start);
+   return ierr;
+}
+
+int MPI_Alltoall ( const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                   void *recvbuf, int recvcount, MPI_Datatype recvtype, MPI_Comm comm )
+{
+   int    size;
+   double start = PMPI_Wtime();
+   int    ierr = PMPI_Alltoall(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype,
+                               comm);
+   PMPI_Comm_size(comm, &size);
+   Record(ALLTOALL, ( sendbuf == MPI_IN_PLACE ) ? size * Bytes(recvcount, recvtype)
+                                                : size * Bytes(sendcount, sendtype), start);
+   return ierr;
+}
+
+int MPI_Reduce ( const void *sendbuf, void *recvbuf, int count, MPI_Datatype type,
+                 MPI_Op op, int root, MPI_Comm comm )
+{
+   double start = PMPI_Wtime();
+   int    ierr = PMPI_Reduce(sendbuf, recvbuf, count, type, op, root, comm);
+   Record(REDUCE, Bytes(count, type), start);
+   return ierr;
+}
+
+int MPI_Iallreduce ( const void *sendbuf, void *recvbuf, int count, MPI_Datatype type,
+                     MPI_Op op, MPI_Comm comm, MPI_Request *request )
+{
+   double start = PMPI_Wtime();
+   int    ierr = PMPI_Iallreduce(sendbuf, recvbuf, count, type, op, comm, request);
+   Record(IALLREDUCE, Bytes(count, type), start);
+   return ierr;
+}
+
+int MPI_Barrier ( MPI_Comm comm )
+{
+   double start = PMPI_Wtime();
+   int    ierr = PMPI_Barrier(comm);
+   Record(BARRIER, 0.0, start);
+   return ierr;
+}
+
+/* Summary of all the tasks on task 0, before the real MPI_Finalize */
+int MPI_Finalize ( void )
+{
+   int    taskid, ntasks, call;
+   double sum[3][NCALLS], mintime[NCALLS], maxtime[NCALLS];
+
+   PMPI_Comm_rank(MPI_COMM_WORLD, &taskid);
+   PMPI_Comm_size(MPI_COMM_WORLD, &ntasks);
+   PMPI_Reduce(profile, sum, 3*NCALLS, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+   PMPI_Reduce(profile[2], mintime, NCALLS, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD);
+   PMPI_Reduce(profile[2], maxtime, NCALLS, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+   if ( taskid == 0 ){
+     fprintf(stderr, "\n######## MPI profile: %d tasks ########\n", ntasks);
+     fprintf(stderr, "%-10s %12s %14s %12s %12s %12s\n", "call", "calls", "bytes",
+             "min (s)", "avg (s)", "max (s)");
+     for(call=0;call<NCALLS;call++){
+       if ( sum[0][call] == 0.0 ) continue;
+       fprintf(stderr, "%-10s %12.0f %14.0f %12.4e %12.4e %12.4e\n", call_names[call],
+               sum[0][call], sum[1][call], mintime[call], sum[2][call]/ntasks,
+               maxtime[call]);
+     }
+     fprintf(stderr, "\n");
+   }
+
+   return PMPI_Finalize();
+}
+
+}